@@ -10,14 +10,19 @@
  */
 
 #include <linux/debugfs.h>
+#include <linux/hrtimer.h>
+#include <linux/kthread.h>
 #include <linux/module.h>
 #include <linux/of_platform.h>
+#include <linux/slab.h>
 #include <video/mipi_display.h>
 
 #include "include/trace/dpu_trace.h"
 #include "panel/panel-samsung-drv.h"
+#include "panel-google-common.h"
 
 #define BIGSURF_DDIC_ID_LEN 8
+/* dimming frames at 120Hz, scaled with the refresh rate to keep the same duration */
 #define BIGSURF_DIMMING_FRAME 32
 
 #define MIPI_DSI_FREQ_DEFAULT 756
@@ -73,8 +78,23 @@ struct bigsurf_panel {
 	struct bigsurf_lhbm_ctl lhbm_ctl;
 	/** @idle_exit_dimming_delay_ts: the delay time to exit dimming */
 	ktime_t idle_exit_dimming_delay_ts;
+	/** @idle_exit_dimming_timer: fires at @idle_exit_dimming_delay_ts */
+	struct hrtimer idle_exit_dimming_timer;
+	/** @idle_exit_dimming_work: restores dimming on @cmd_worker once the timer fires */
+	struct kthread_work idle_exit_dimming_work;
 	/** @panel_brightness: the brightness of the panel */
 	u16 panel_brightness;
+	/** @hw_dimming_frame: dimming frame count programmed in HW, 0 means unknown */
+	u8 hw_dimming_frame;
+	/** @bcl: cooling device used by BCL to shed panel current */
+	struct panel_google_bcl bcl;
+	/**
+	 * @cmd_worker: high priority worker owned by this panel, deferred panel commands are
+	 *		queued here instead of the shared system workqueue
+	 */
+	struct kthread_worker *cmd_worker;
+	/** @init_set: init command set resolved for the panel revision */
+	struct panel_google_cmd_set init_set;
 };
 
 #define to_spanel(ctx) container_of(ctx, struct bigsurf_panel, base)
@@ -433,6 +453,21 @@ static bool bigsurf_rr_need_te_high(struct exynos_panel *ctx,
 	return false;
 }
 
+static void bigsurf_update_dimming_frame(struct exynos_panel *ctx, int vrefresh)
+{
+	struct bigsurf_panel *spanel = to_spanel(ctx);
+	const u8 dimming_frame = max(BIGSURF_DIMMING_FRAME * vrefresh / 120, 1);
+
+	if (spanel->hw_dimming_frame == dimming_frame)
+		return;
+
+	EXYNOS_DCS_BUF_ADD(ctx, 0xF0, 0x55, 0xAA, 0x52, 0x08, 0x00);
+	EXYNOS_DCS_BUF_ADD(ctx, 0xB2, 0x19);
+	EXYNOS_DCS_BUF_ADD(ctx, 0x6F, 0x05);
+	EXYNOS_DCS_BUF_ADD(ctx, 0xB2, dimming_frame, dimming_frame);
+	spanel->hw_dimming_frame = dimming_frame;
+}
+
 static void bigsurf_change_frequency(struct exynos_panel *ctx,
 				    const struct exynos_panel_mode *pmode)
 {
@@ -453,14 +488,19 @@ static void bigsurf_change_frequency(struct exynos_panel *ctx,
 	if (!IS_HBM_ON(ctx->hbm_mode)) {
 		if (vrefresh == 120) {
 			EXYNOS_DCS_BUF_ADD(ctx, 0x2F, 0x00);
-			EXYNOS_DCS_BUF_ADD_AND_FLUSH(ctx, MIPI_DCS_SET_GAMMA_CURVE, 0x00);
+			EXYNOS_DCS_BUF_ADD(ctx, MIPI_DCS_SET_GAMMA_CURVE, 0x00);
 		} else {
 			EXYNOS_DCS_BUF_ADD(ctx, 0x2F, 0x30);
 			EXYNOS_DCS_BUF_ADD(ctx, 0xF0, 0x55, 0xAA, 0x52, 0x08, 0x00);
 			EXYNOS_DCS_BUF_ADD(ctx, 0x6F, 0xB0);
-			EXYNOS_DCS_BUF_ADD_AND_FLUSH(ctx, 0xBA, 0x41);
+			EXYNOS_DCS_BUF_ADD(ctx, 0xBA, 0x41);
 		}
+		bigsurf_update_dimming_frame(ctx, vrefresh);
+		/* Empty command is for flush */
+		EXYNOS_DCS_BUF_ADD_AND_FLUSH(ctx, 0x00);
 	} else {
+		/* flushed together with the IRC update */
+		bigsurf_update_dimming_frame(ctx, vrefresh);
 		bigsurf_update_irc(ctx, ctx->hbm_mode, vrefresh);
 	}
 
@@ -483,6 +523,36 @@ static void bigsurf_set_dimming_on(struct exynos_panel *ctx,
 	dev_dbg(ctx->dev, "%s dimming_on=%d\n", __func__, dimming_on);
 }
 
+static void bigsurf_idle_exit_dimming_work(struct kthread_work *work)
+{
+	struct bigsurf_panel *spanel = container_of(work, struct bigsurf_panel,
+						    idle_exit_dimming_work);
+	struct exynos_panel *ctx = &spanel->base;
+
+	mutex_lock(&ctx->mode_lock);
+	/* the deadline is cleared if the panel was reset or went back to LP meanwhile */
+	if (spanel->idle_exit_dimming_delay_ts && is_panel_active(ctx) &&
+	    !ctx->current_mode->exynos_mode.is_lp_mode) {
+		DPU_ATRACE_BEGIN(__func__);
+		EXYNOS_DCS_WRITE_SEQ(ctx, MIPI_DCS_WRITE_CONTROL_DISPLAY,
+				     ctx->dimming_on ? 0x28 : 0x20);
+		DPU_ATRACE_END(__func__);
+		dev_dbg(ctx->dev, "%s: dimming_on=%d\n", __func__, ctx->dimming_on);
+	}
+	spanel->idle_exit_dimming_delay_ts = 0;
+	mutex_unlock(&ctx->mode_lock);
+}
+
+static enum hrtimer_restart bigsurf_idle_exit_dimming_timer(struct hrtimer *timer)
+{
+	struct bigsurf_panel *spanel = container_of(timer, struct bigsurf_panel,
+						    idle_exit_dimming_timer);
+
+	kthread_queue_work(spanel->cmd_worker, &spanel->idle_exit_dimming_work);
+
+	return HRTIMER_NORESTART;
+}
+
 static void bigsurf_set_nolp_mode(struct exynos_panel *ctx,
 				  const struct exynos_panel_mode *pmode)
 {
@@ -500,21 +570,12 @@ static void bigsurf_set_nolp_mode(struct exynos_panel *ctx,
 	bigsurf_change_frequency(ctx, pmode);
 	spanel->idle_exit_dimming_delay_ts = ktime_add_us(
 		ktime_get(), 100 + EXYNOS_VREFRESH_TO_PERIOD_USEC(vrefresh) * 2);
+	hrtimer_start(&spanel->idle_exit_dimming_timer, spanel->idle_exit_dimming_delay_ts,
+		      HRTIMER_MODE_ABS);
 
 	dev_info(ctx->dev, "exit LP mode\n");
 }
 
-static void bigsurf_dimming_frame_setting(struct exynos_panel *ctx, u8 dimming_frame)
-{
-	if (!dimming_frame)
-		dimming_frame = 0x01;
-
-	EXYNOS_DCS_BUF_ADD(ctx, 0xF0, 0x55, 0xAA, 0x52, 0x08, 0x00);
-	EXYNOS_DCS_BUF_ADD(ctx, 0xB2, 0x19);
-	EXYNOS_DCS_BUF_ADD(ctx, 0x6F, 0x05);
-	EXYNOS_DCS_BUF_ADD_AND_FLUSH(ctx, 0xB2, dimming_frame, dimming_frame);
-}
-
 static int bigsurf_enable(struct drm_panel *panel)
 {
 	struct exynos_panel *ctx = container_of(panel, struct exynos_panel, panel);
@@ -529,9 +590,10 @@ static int bigsurf_enable(struct drm_panel *panel)
 	dev_dbg(ctx->dev, "%s\n", __func__);
 
 	exynos_panel_reset(ctx);
-	exynos_panel_send_cmd_set(ctx, &bigsurf_init_cmd_set);
+	panel_google_send_cmd_set(ctx, &bigsurf_init_cmd_set, &spanel->init_set);
+	spanel->hw_dimming_frame = 0;
 	bigsurf_change_frequency(ctx, pmode);
-	bigsurf_dimming_frame_setting(ctx, BIGSURF_DIMMING_FRAME);
+	hrtimer_cancel(&spanel->idle_exit_dimming_timer);
 	spanel->idle_exit_dimming_delay_ts = 0;
 
 	if (!pmode->exynos_mode.is_lp_mode) {
@@ -721,16 +783,14 @@ static int bigsurf_set_brightness(struct exynos_panel *ctx, u16 br)
 		return 0;
 	}
 
+	if (br > spanel->bcl.max_dbv) {
+		dev_dbg(ctx->dev, "%s: cap dbv %u to %u\n", __func__, br, spanel->bcl.max_dbv);
+		br = spanel->bcl.max_dbv;
+	}
+
 	if (br) {
 		if (ctx->hbm.local_hbm.enabled)
 			bigsurf_set_local_hbm_background_brightness(ctx, br);
-
-		if (spanel->idle_exit_dimming_delay_ts &&
-			(ktime_sub(spanel->idle_exit_dimming_delay_ts, ktime_get()) <= 0)) {
-			EXYNOS_DCS_BUF_ADD(ctx, MIPI_DCS_WRITE_CONTROL_DISPLAY,
-						ctx->dimming_on ? 0x28 : 0x20);
-			spanel->idle_exit_dimming_delay_ts = 0;
-		}
 	}
 
 	/* Check for passing brightness threshold */
@@ -880,6 +940,9 @@ static void bigsurf_get_panel_rev(struct exynos_panel *ctx, u32 id)
 	const u8 sub = (build_code & 0x0C) >> 2;
 
 	exynos_panel_get_panel_rev(ctx, main | sub);
+
+	/* filter and pack the command sets once the panel revision is known */
+	panel_google_resolve_cmd_set(ctx, &bigsurf_init_cmd_set, &to_spanel(ctx)->init_set);
 }
 
 static int bigsurf_read_id(struct exynos_panel *ctx)
@@ -1083,26 +1146,62 @@ static void bigsurf_lhbm_brightness_init(struct exynos_panel *ctx)
 			grp, LHBM_BRT_LEN, spanel->lhbm_ctl.brt_overdrive[grp]);
 }
 
+/* names of the resolved command sets, only @init_set on this panel */
+static const char * const bigsurf_cmd_set_names[] = { "init" };
+
 static void bigsurf_panel_init(struct exynos_panel *ctx)
 {
 	struct bigsurf_panel *spanel = to_spanel(ctx);
 	struct dentry *csroot = ctx->debugfs_cmdset_entry;
 
 	exynos_panel_debugfs_create_cmdset(ctx, csroot, &bigsurf_init_cmd_set, "init");
-	bigsurf_dimming_frame_setting(ctx, BIGSURF_DIMMING_FRAME);
+	panel_google_cmd_set_debugfs_init(ctx->dev, ctx->debugfs_entry, &spanel->init_set,
+					  bigsurf_cmd_set_names, ARRAY_SIZE(bigsurf_cmd_set_names));
 	bigsurf_lhbm_brightness_init(ctx);
 	spanel->panel_brightness = exynos_panel_get_brightness(ctx);
 }
 
+static void bigsurf_cancel_cmd_works(void *data)
+{
+	struct bigsurf_panel *spanel = data;
+
+	kthread_cancel_delayed_work_sync(&spanel->bcl.restore_work);
+	hrtimer_cancel(&spanel->idle_exit_dimming_timer);
+	kthread_cancel_work_sync(&spanel->idle_exit_dimming_work);
+}
+
 static int bigsurf_panel_probe(struct mipi_dsi_device *dsi)
 {
 	struct bigsurf_panel *spanel;
+	int ret;
 
 	spanel = devm_kzalloc(&dsi->dev, sizeof(*spanel), GFP_KERNEL);
 	if (!spanel)
 		return -ENOMEM;
 
-	return exynos_panel_common_init(dsi, &spanel->base);
+	/* no ACL control in the driver, so BCL mitigation caps dbv only */
+	panel_google_bcl_init(&spanel->bcl, &spanel->base, panel_google_bcl_brt_cap_max_dbv,
+			      panel_google_bcl_reapply_brightness);
+	hrtimer_init(&spanel->idle_exit_dimming_timer, CLOCK_MONOTONIC, HRTIMER_MODE_ABS);
+	spanel->idle_exit_dimming_timer.function = bigsurf_idle_exit_dimming_timer;
+	kthread_init_work(&spanel->idle_exit_dimming_work, bigsurf_idle_exit_dimming_work);
+
+	spanel->cmd_worker = panel_google_create_cmd_worker(&dsi->dev);
+	if (IS_ERR(spanel->cmd_worker))
+		return PTR_ERR(spanel->cmd_worker);
+
+	ret = exynos_panel_common_init(dsi, &spanel->base);
+	if (ret)
+		return ret;
+
+	ret = devm_add_action_or_reset(&dsi->dev, bigsurf_cancel_cmd_works, spanel);
+	if (ret)
+		return ret;
+
+	panel_google_bcl_register(&spanel->bcl, &dsi->dev, spanel->cmd_worker,
+				  "display-bcl-bigsurf");
+
+	return 0;
 }
 
 static const struct drm_panel_funcs bigsurf_drm_funcs = {
@@ -0,0 +1,658 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+/*
+ * Helpers shared by the Google panel drivers.
+ *
+ * Copyright (c) 2023 Google LLC
+ */
+
+#ifndef _PANEL_GOOGLE_COMMON_H_
+#define _PANEL_GOOGLE_COMMON_H_
+
+#include <linux/debugfs.h>
+#include <linux/delay.h>
+#include <linux/kthread.h>
+#include <linux/seq_file.h>
+#include <linux/thermal.h>
+
+#include "include/trace/dpu_trace.h"
+#include "panel/panel-samsung-drv.h"
+
+static inline void panel_google_destroy_cmd_worker(void *data)
+{
+	kthread_destroy_worker(data);
+}
+
+/**
+ * panel_google_create_cmd_worker - create the high priority command worker of a panel
+ * @dev: panel device, the worker is destroyed when it's unbound
+ *
+ * Deferred panel commands run on this worker, so they don't wait behind unrelated work on
+ * the system workqueues. Returns the worker or an ERR_PTR().
+ */
+static inline struct kthread_worker *panel_google_create_cmd_worker(struct device *dev)
+{
+	struct kthread_worker *worker;
+	int ret;
+
+	worker = kthread_create_worker(0, "%s-cmd", dev_name(dev));
+	if (IS_ERR(worker))
+		return worker;
+	sched_set_fifo(worker->task);
+
+	ret = devm_add_action_or_reset(dev, panel_google_destroy_cmd_worker, worker);
+	if (ret)
+		return ERR_PTR(ret);
+
+	return worker;
+}
+
+/*
+ * BCL mitigation states: state 1 caps dbv at the top of the normal range, state 2 caps it
+ * further. The helper only caps dbv, a panel can turn off more from its apply_dbv_cap.
+ */
+#define PANEL_GOOGLE_BCL_MAX_STATE 2
+/* dbv step and interval for restoring brightness after BCL mitigation ends */
+#define PANEL_GOOGLE_BCL_RESTORE_DBV_STEP 256
+#define PANEL_GOOGLE_BCL_RESTORE_INTERVAL_MS 200
+
+/**
+ * struct panel_google_bcl - BCL cooling device capping the panel brightness
+ * @ctx: panel the cooling device belongs to
+ * @cdev: registered cooling device, NULL if registration failed
+ * @worker: worker running @restore_work
+ * @state: current mitigation state, 0 means not mitigated
+ * @max_dbv: dbv cap in effect, restored gradually after mitigation ends
+ * @restore_work: steps @max_dbv back up after mitigation ends
+ * @get_max_dbv: returns the dbv cap of a mitigation state
+ * @apply_dbv_cap: re-applies the brightness after @max_dbv or @state changed, mode_lock is held
+ */
+struct panel_google_bcl {
+	struct exynos_panel *ctx;
+	struct thermal_cooling_device *cdev;
+	struct kthread_worker *worker;
+	unsigned long state;
+	u16 max_dbv;
+	struct kthread_delayed_work restore_work;
+	u16 (*get_max_dbv)(struct exynos_panel *ctx, unsigned long state);
+	void (*apply_dbv_cap)(struct exynos_panel *ctx);
+};
+
+/* dbv caps derived from the brightness capability of the panel */
+static inline u16 panel_google_bcl_brt_cap_max_dbv(struct exynos_panel *ctx, unsigned long state)
+{
+	const struct brightness_capability *brt_cap = ctx->desc->brt_capability;
+
+	if (!brt_cap)
+		return U16_MAX;
+
+	if (!state)
+		return brt_cap->hbm.level.max;
+
+	return (state == 1) ? brt_cap->normal.level.max : brt_cap->normal.level.max / 2;
+}
+
+/* re-apply the requested brightness through the set_brightness callback of the panel */
+static inline void panel_google_bcl_reapply_brightness(struct exynos_panel *ctx)
+{
+	const struct exynos_panel_funcs *funcs = ctx->desc->exynos_panel_func;
+
+	if (ctx->panel_state != PANEL_STATE_NORMAL || !ctx->current_mode ||
+	    ctx->current_mode->exynos_mode.is_lp_mode || !funcs || !funcs->set_brightness)
+		return;
+
+	DPU_ATRACE_BEGIN(__func__);
+	funcs->set_brightness(ctx, exynos_panel_get_brightness(ctx));
+	DPU_ATRACE_END(__func__);
+}
+
+static inline void panel_google_bcl_restore_work(struct kthread_work *work)
+{
+	struct panel_google_bcl *bcl = container_of(work, struct panel_google_bcl,
+						    restore_work.work);
+	struct exynos_panel *ctx = bcl->ctx;
+	u16 target;
+
+	mutex_lock(&ctx->mode_lock);
+	target = bcl->get_max_dbv(ctx, bcl->state);
+	if (bcl->max_dbv < target) {
+		bcl->max_dbv = min_t(int, target, bcl->max_dbv + PANEL_GOOGLE_BCL_RESTORE_DBV_STEP);
+		bcl->apply_dbv_cap(ctx);
+		if (bcl->max_dbv < target)
+			kthread_queue_delayed_work(bcl->worker, &bcl->restore_work,
+					msecs_to_jiffies(PANEL_GOOGLE_BCL_RESTORE_INTERVAL_MS));
+	}
+	mutex_unlock(&ctx->mode_lock);
+}
+
+static inline int panel_google_bcl_get_max_state(struct thermal_cooling_device *cdev,
+						 unsigned long *state)
+{
+	*state = PANEL_GOOGLE_BCL_MAX_STATE;
+
+	return 0;
+}
+
+static inline int panel_google_bcl_get_cur_state(struct thermal_cooling_device *cdev,
+						 unsigned long *state)
+{
+	struct panel_google_bcl *bcl = cdev->devdata;
+
+	*state = bcl->state;
+
+	return 0;
+}
+
+/*
+ * Cap the brightness right away when mitigation is raised, so the panel current drops within
+ * one frame. Lowering the mitigation restores the brightness gradually.
+ */
+static inline int panel_google_bcl_set_cur_state(struct thermal_cooling_device *cdev,
+						 unsigned long state)
+{
+	struct panel_google_bcl *bcl = cdev->devdata;
+	struct exynos_panel *ctx = bcl->ctx;
+	u16 target;
+
+	if (state > PANEL_GOOGLE_BCL_MAX_STATE)
+		return -EINVAL;
+
+	mutex_lock(&ctx->mode_lock);
+	if (state == bcl->state)
+		goto unlock;
+
+	dev_info(ctx->dev, "%s: %lu->%lu\n", __func__, bcl->state, state);
+	bcl->state = state;
+	target = bcl->get_max_dbv(ctx, state);
+	if (target <= bcl->max_dbv)
+		/* a pending restore work finds nothing to do and doesn't re-queue itself */
+		bcl->max_dbv = target;
+	else
+		kthread_mod_delayed_work(bcl->worker, &bcl->restore_work,
+					 msecs_to_jiffies(PANEL_GOOGLE_BCL_RESTORE_INTERVAL_MS));
+	/* settings following @state, e.g. an ACL floor, change right away in both directions */
+	bcl->apply_dbv_cap(ctx);
+unlock:
+	mutex_unlock(&ctx->mode_lock);
+
+	return 0;
+}
+
+static const struct thermal_cooling_device_ops panel_google_bcl_cooling_ops = {
+	.get_max_state = panel_google_bcl_get_max_state,
+	.get_cur_state = panel_google_bcl_get_cur_state,
+	.set_cur_state = panel_google_bcl_set_cur_state,
+};
+
+static inline void panel_google_bcl_init(struct panel_google_bcl *bcl, struct exynos_panel *ctx,
+		u16 (*get_max_dbv)(struct exynos_panel *ctx, unsigned long state),
+		void (*apply_dbv_cap)(struct exynos_panel *ctx))
+{
+	bcl->ctx = ctx;
+	bcl->state = 0;
+	bcl->max_dbv = U16_MAX;
+	bcl->get_max_dbv = get_max_dbv;
+	bcl->apply_dbv_cap = apply_dbv_cap;
+	kthread_init_delayed_work(&bcl->restore_work, panel_google_bcl_restore_work);
+}
+
+/*
+ * Register the cooling device once @worker exists. @type names the panel, so the BCL
+ * configuration can tell the cooling devices of different panels apart.
+ */
+static inline void panel_google_bcl_register(struct panel_google_bcl *bcl, struct device *dev,
+					     struct kthread_worker *worker, const char *type)
+{
+	bcl->worker = worker;
+	bcl->cdev = devm_thermal_of_cooling_device_register(dev, dev->of_node, type, bcl,
+							     &panel_google_bcl_cooling_ops);
+	if (IS_ERR(bcl->cdev)) {
+		dev_warn(dev, "failed to register %s cooling device: %ld\n", type,
+			 PTR_ERR(bcl->cdev));
+		bcl->cdev = NULL;
+	}
+}
+
+/* DBV range covered by the brightness lookup table */
+#define PANEL_GOOGLE_BRT_LUT_SIZE 4096
+/* LHBM overdrive groups: 0 nit, up to 6 nits, up to 50 nits and up to 300 nits */
+#define PANEL_GOOGLE_LHBM_OD_GRP_MAX 4
+/* gray levels below this always use the 0 nit overdrive group */
+#define PANEL_GOOGLE_LHBM_OD_MIN_GRAY 15
+
+/**
+ * struct panel_google_brt_lut_entry - brightness data precomputed for one DBV
+ * @nits: full white luminance at this DBV
+ * @lhbm_gray_max: largest LHBM gray level that still falls in each overdrive group
+ */
+struct panel_google_brt_lut_entry {
+	u16 nits;
+	u8 lhbm_gray_max[PANEL_GOOGLE_LHBM_OD_GRP_MAX];
+};
+
+/**
+ * struct panel_google_brt_lut - brightness lookup table indexed by DBV
+ * @ctx: panel the table belongs to
+ * @entries: table entries
+ * @size: number of valid entries in @entries
+ */
+struct panel_google_brt_lut {
+	struct exynos_panel *ctx;
+	struct panel_google_brt_lut_entry *entries;
+	u32 size;
+};
+
+/* upper luminance bound of each LHBM overdrive group */
+static const u32 panel_google_lhbm_od_max_nits[PANEL_GOOGLE_LHBM_OD_GRP_MAX] = {
+	0, 6, 50, 300,
+};
+
+/*
+ * Gamma 2.2 up to the top of the normal range, then the linear HBM model of the panel given
+ * by @hbm_slope and @hbm_offset.
+ */
+static inline u32 panel_google_calc_nits(const struct brightness_capability *brt_cap, u32 dbv,
+					 int hbm_slope, int hbm_offset)
+{
+	if (dbv <= brt_cap->normal.level.max)
+		return panel_cmn_calc_gamma_2_2_luminance(dbv, brt_cap->normal.level.max,
+							  brt_cap->normal.nits.max);
+
+	return panel_cmn_calc_linear_luminance(dbv, hbm_slope, hbm_offset);
+}
+
+/* allocate the table, lookups return entry 0 until panel_google_brt_lut_init() fills it */
+static inline int panel_google_brt_lut_alloc(struct panel_google_brt_lut *lut,
+					     struct exynos_panel *ctx, struct device *dev)
+{
+	lut->ctx = ctx;
+	lut->entries = devm_kcalloc(dev, PANEL_GOOGLE_BRT_LUT_SIZE, sizeof(*lut->entries),
+				    GFP_KERNEL);
+	if (!lut->entries)
+		return -ENOMEM;
+	lut->size = 1;
+
+	return 0;
+}
+
+/**
+ * panel_google_brt_lut_init - fill the brightness lookup table
+ * @lut: table allocated by panel_google_brt_lut_alloc()
+ * @brt_cap: brightness capability of the panel
+ * @hbm_slope: slope of the linear luminance model above the normal range
+ * @hbm_offset: offset of the linear luminance model above the normal range
+ *
+ * Evaluate the luminance model once for every DBV so that nits and LHBM overdrive group
+ * lookups are a table index at runtime. Since luminance only grows with DBV, the gray bound
+ * of each group is walked down from the previous entry instead of being searched from scratch.
+ */
+static inline void panel_google_brt_lut_init(struct panel_google_brt_lut *lut,
+					     const struct brightness_capability *brt_cap,
+					     int hbm_slope, int hbm_offset)
+{
+	struct panel_google_brt_lut_entry *entries = lut->entries;
+	u32 size = min_t(u32, brt_cap->hbm.level.max + 1, PANEL_GOOGLE_BRT_LUT_SIZE);
+	u32 gray[PANEL_GOOGLE_LHBM_OD_GRP_MAX];
+	u32 dbv, nits, prev_nits = 0;
+	int grp;
+
+	for (grp = 0; grp < PANEL_GOOGLE_LHBM_OD_GRP_MAX; grp++)
+		gray[grp] = 255;
+
+	for (dbv = 0; dbv < size; dbv++) {
+		nits = panel_google_calc_nits(brt_cap, dbv, hbm_slope, hbm_offset);
+		if (nits < prev_nits) {
+			for (grp = 0; grp < PANEL_GOOGLE_LHBM_OD_GRP_MAX; grp++)
+				gray[grp] = 255;
+		}
+		prev_nits = nits;
+
+		entries[dbv].nits = nits;
+		entries[dbv].lhbm_gray_max[0] = PANEL_GOOGLE_LHBM_OD_MIN_GRAY - 1;
+		for (grp = 1; grp < PANEL_GOOGLE_LHBM_OD_GRP_MAX; grp++) {
+			while (gray[grp] > 0 && panel_cmn_calc_gamma_2_2_luminance(gray[grp], 255,
+					nits) >= panel_google_lhbm_od_max_nits[grp])
+				gray[grp]--;
+			entries[dbv].lhbm_gray_max[grp] = gray[grp];
+		}
+	}
+
+	lut->size = size;
+}
+
+static inline const struct panel_google_brt_lut_entry *
+panel_google_get_brt_lut(const struct panel_google_brt_lut *lut, u32 dbv)
+{
+	return &lut->entries[min(dbv, lut->size - 1)];
+}
+
+/* LHBM overdrive group of @gray at @dbv, PANEL_GOOGLE_LHBM_OD_GRP_MAX if none */
+static inline u32 panel_google_get_lhbm_od_group(const struct panel_google_brt_lut *lut,
+						 u32 dbv, u32 gray)
+{
+	const struct panel_google_brt_lut_entry *entry = panel_google_get_brt_lut(lut, dbv);
+	u32 grp;
+
+	for (grp = 0; grp < PANEL_GOOGLE_LHBM_OD_GRP_MAX; grp++) {
+		if (gray <= entry->lhbm_gray_max[grp])
+			break;
+	}
+
+	return grp;
+}
+
+static inline int panel_google_brt_lut_nits_show(struct seq_file *m, void *data)
+{
+	const struct panel_google_brt_lut *lut = m->private;
+	u32 dbv = exynos_panel_get_brightness(lut->ctx);
+
+	seq_printf(m, "dbv: %u nits: %u\n", dbv, panel_google_get_brt_lut(lut, dbv)->nits);
+
+	return 0;
+}
+
+DEFINE_SHOW_ATTRIBUTE(panel_google_brt_lut_nits);
+
+/* "nits" debugfs file showing the luminance at the current brightness */
+static inline void panel_google_brt_lut_debugfs_init(struct panel_google_brt_lut *lut,
+						     struct dentry *dir)
+{
+	debugfs_create_file("nits", 0444, dir, lut, &panel_google_brt_lut_nits_fops);
+}
+
+/**
+ * enum panel_google_pwr_on_step - steps of the power on sequence
+ * @PANEL_GOOGLE_PWR_ON_PREPARE: regulators are enabled
+ * @PANEL_GOOGLE_PWR_ON_RESET: reset sequence is done
+ * @PANEL_GOOGLE_PWR_ON_INIT: init commands are sent
+ * @PANEL_GOOGLE_PWR_ON_ENABLE: panel enable is done
+ * @PANEL_GOOGLE_PWR_ON_STEP_MAX: placeholder, counter for number of steps
+ */
+enum panel_google_pwr_on_step {
+	PANEL_GOOGLE_PWR_ON_PREPARE = 0,
+	PANEL_GOOGLE_PWR_ON_RESET,
+	PANEL_GOOGLE_PWR_ON_INIT,
+	PANEL_GOOGLE_PWR_ON_ENABLE,
+	PANEL_GOOGLE_PWR_ON_STEP_MAX,
+};
+
+/**
+ * struct panel_google_pwr_on_timeline - timestamps of the latest power on
+ * @start: time the latest panel prepare started
+ * @us: time each step finished, relative to @start
+ */
+struct panel_google_pwr_on_timeline {
+	ktime_t start;
+	s64 us[PANEL_GOOGLE_PWR_ON_STEP_MAX];
+};
+
+static inline void panel_google_mark_pwr_on(struct panel_google_pwr_on_timeline *tl,
+					    enum panel_google_pwr_on_step step)
+{
+	tl->us[step] = ktime_us_delta(ktime_get(), tl->start);
+}
+
+/* exynos_panel_prepare() starting a new timeline, for the drm_panel prepare callback */
+static inline int panel_google_pwr_on_prepare(struct drm_panel *panel,
+					      struct panel_google_pwr_on_timeline *tl)
+{
+	int ret;
+
+	tl->start = ktime_get();
+	memset(tl->us, 0, sizeof(tl->us));
+
+	DPU_ATRACE_BEGIN(__func__);
+	ret = exynos_panel_prepare(panel);
+	DPU_ATRACE_END(__func__);
+	if (!ret)
+		panel_google_mark_pwr_on(tl, PANEL_GOOGLE_PWR_ON_PREPARE);
+
+	return ret;
+}
+
+/* mark the end of panel enable and log the whole timeline */
+static inline void panel_google_pwr_on_done(struct panel_google_pwr_on_timeline *tl,
+					    struct device *dev)
+{
+	panel_google_mark_pwr_on(tl, PANEL_GOOGLE_PWR_ON_ENABLE);
+	dev_dbg(dev, "power on: prepare %lld reset %lld init %lld enable %lld us\n",
+		tl->us[PANEL_GOOGLE_PWR_ON_PREPARE], tl->us[PANEL_GOOGLE_PWR_ON_RESET],
+		tl->us[PANEL_GOOGLE_PWR_ON_INIT], tl->us[PANEL_GOOGLE_PWR_ON_ENABLE]);
+}
+
+static inline int panel_google_pwr_on_timeline_show(struct seq_file *m, void *data)
+{
+	const struct panel_google_pwr_on_timeline *tl = m->private;
+	static const char * const names[PANEL_GOOGLE_PWR_ON_STEP_MAX] = {
+		[PANEL_GOOGLE_PWR_ON_PREPARE] = "prepare",
+		[PANEL_GOOGLE_PWR_ON_RESET] = "reset",
+		[PANEL_GOOGLE_PWR_ON_INIT] = "init",
+		[PANEL_GOOGLE_PWR_ON_ENABLE] = "enable",
+	};
+	int i;
+
+	for (i = 0; i < PANEL_GOOGLE_PWR_ON_STEP_MAX; i++)
+		seq_printf(m, "%s: %lld us\n", names[i], tl->us[i]);
+
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(panel_google_pwr_on_timeline);
+
+static inline void panel_google_pwr_on_debugfs_init(struct panel_google_pwr_on_timeline *tl,
+						    struct dentry *dir)
+{
+	debugfs_create_file("power_on_timeline", 0444, dir, tl,
+			    &panel_google_pwr_on_timeline_fops);
+}
+
+/* limits of one packed transfer, kept well within the DSIM header and payload FIFOs */
+#define PANEL_GOOGLE_CMD_BATCH_MAX_PKTS 16
+#define PANEL_GOOGLE_CMD_BATCH_MAX_BYTES 512
+
+/**
+ * struct panel_google_cmd - command of a set that applies to the panel revision
+ * @cmd: the command
+ * @flags: DSI message flags, EXYNOS_DSI_MSG_QUEUE unless the command ends a transfer
+ */
+struct panel_google_cmd {
+	const struct exynos_dsi_cmd *cmd;
+	u16 flags;
+};
+
+/**
+ * struct panel_google_cmd_set - command set filtered for the panel revision and packed
+ * @cmds: commands that apply to the panel revision, NULL until resolved
+ * @num_cmd: number of entries in @cmds
+ * @num_xfers: number of DSI transfers @cmds are packed into
+ */
+struct panel_google_cmd_set {
+	struct panel_google_cmd *cmds;
+	u32 num_cmd;
+	u32 num_xfers;
+};
+
+static inline bool panel_google_cmd_applies(struct exynos_panel *ctx,
+					    const struct exynos_dsi_cmd *c)
+{
+	return !c->panel_rev || (c->panel_rev & ctx->panel_rev);
+}
+
+/* next command after @c that applies to the panel revision, or @end */
+static inline const struct exynos_dsi_cmd *
+panel_google_next_cmd(struct exynos_panel *ctx, const struct exynos_dsi_cmd *c,
+		      const struct exynos_dsi_cmd *end)
+{
+	for (c++; c < end && !panel_google_cmd_applies(ctx, c); c++)
+		;
+
+	return c;
+}
+
+/*
+ * DSI message flags of @c, followed by @next in the set. A transfer ends after a command
+ * with a delay, at the end of the set, or before @next would exceed the transfer limits.
+ * @pkts and @bytes count what is queued in the current transfer.
+ */
+static inline u16 panel_google_cmd_flags(const struct exynos_dsi_cmd *c,
+					 const struct exynos_dsi_cmd *next,
+					 const struct exynos_dsi_cmd *end, u32 *pkts, u32 *bytes)
+{
+	(*pkts)++;
+	*bytes += c->cmd_len;
+	if (next == end || c->delay_ms || *pkts == PANEL_GOOGLE_CMD_BATCH_MAX_PKTS ||
+	    *bytes + next->cmd_len > PANEL_GOOGLE_CMD_BATCH_MAX_BYTES) {
+		*pkts = 0;
+		*bytes = 0;
+		return 0;
+	}
+
+	return EXYNOS_DSI_MSG_QUEUE;
+}
+
+static inline void panel_google_send_cmd(struct exynos_panel *ctx,
+					 const struct exynos_dsi_cmd *c, u16 flags)
+{
+	struct mipi_dsi_device *dsi = to_mipi_dsi_device(ctx->dev);
+	int ret;
+
+	ret = exynos_dsi_dcs_write_buffer(dsi, c->cmd, c->cmd_len, flags);
+	if (ret < 0)
+		dev_err(ctx->dev, "%s: failed to send cmd 0x%02X: %d\n", __func__, c->cmd[0], ret);
+	if (c->delay_ms)
+		usleep_range(c->delay_ms * 1000, c->delay_ms * 1000 + 10);
+}
+
+/* keep the commands of @cmd_set that apply to the panel revision in @rset, packed */
+static inline void panel_google_pack_cmd_set(struct exynos_panel *ctx,
+					     const struct exynos_dsi_cmd_set *cmd_set,
+					     struct panel_google_cmd_set *rset)
+{
+	const struct exynos_dsi_cmd *c, *next;
+	const struct exynos_dsi_cmd *end = cmd_set->cmds + cmd_set->num_cmd;
+	u32 pkts = 0, bytes = 0;
+
+	rset->num_cmd = 0;
+	rset->num_xfers = 0;
+
+	for (c = cmd_set->cmds; c < end; c = next) {
+		struct panel_google_cmd *r;
+
+		next = panel_google_next_cmd(ctx, c, end);
+		if (!panel_google_cmd_applies(ctx, c))
+			continue;
+
+		r = &rset->cmds[rset->num_cmd++];
+		r->cmd = c;
+		r->flags = panel_google_cmd_flags(c, next, end, &pkts, &bytes);
+		if (!r->flags)
+			rset->num_xfers++;
+	}
+}
+
+/**
+ * panel_google_resolve_cmd_set - filter and pack a command set for the panel revision
+ * @ctx: panel struct
+ * @cmd_set: command set to resolve
+ * @rset: resolved copy of @cmd_set, allocated on the first call
+ *
+ * Called once the panel revision is known, so revision checks and the transfer packing
+ * aren't redone on every send.
+ */
+static inline void panel_google_resolve_cmd_set(struct exynos_panel *ctx,
+						const struct exynos_dsi_cmd_set *cmd_set,
+						struct panel_google_cmd_set *rset)
+{
+	if (!rset->cmds)
+		rset->cmds = devm_kcalloc(ctx->dev, cmd_set->num_cmd, sizeof(*rset->cmds),
+					  GFP_KERNEL);
+	if (!rset->cmds) {
+		dev_warn(ctx->dev, "%s: no memory to resolve cmd set\n", __func__);
+		return;
+	}
+	panel_google_pack_cmd_set(ctx, cmd_set, rset);
+}
+
+/**
+ * panel_google_send_cmd_set - send a command set in as few DSI transfers as possible
+ * @ctx: panel struct
+ * @cmd_set: command set to send
+ * @rset: copy of @cmd_set resolved by panel_google_resolve_cmd_set()
+ *
+ * Commands are queued and only flushed at the end of each packed transfer, instead of
+ * sending each command as its own transfer. Command order and delays are unchanged.
+ * Before the panel revision is read @rset isn't resolved yet, and @cmd_set is packed
+ * while it's sent.
+ */
+static inline void panel_google_send_cmd_set(struct exynos_panel *ctx,
+					     const struct exynos_dsi_cmd_set *cmd_set,
+					     const struct panel_google_cmd_set *rset)
+{
+	const struct exynos_dsi_cmd *c, *next;
+	const struct exynos_dsi_cmd *end = cmd_set->cmds + cmd_set->num_cmd;
+	u32 i, pkts = 0, bytes = 0;
+
+	if (rset->cmds) {
+		for (i = 0; i < rset->num_cmd; i++)
+			panel_google_send_cmd(ctx, rset->cmds[i].cmd, rset->cmds[i].flags);
+		return;
+	}
+
+	for (c = cmd_set->cmds; c < end; c = next) {
+		next = panel_google_next_cmd(ctx, c, end);
+		if (panel_google_cmd_applies(ctx, c))
+			panel_google_send_cmd(ctx, c,
+					      panel_google_cmd_flags(c, next, end, &pkts, &bytes));
+	}
+}
+
+/**
+ * struct panel_google_cmd_set_report - resolved command sets shown in debugfs
+ * @sets: resolved command sets
+ * @names: name of each entry in @sets
+ * @num: number of entries in @sets
+ */
+struct panel_google_cmd_set_report {
+	const struct panel_google_cmd_set *sets;
+	const char * const *names;
+	u32 num;
+};
+
+static inline int panel_google_cmd_set_xfers_show(struct seq_file *m, void *data)
+{
+	const struct panel_google_cmd_set_report *report = m->private;
+	u32 i;
+
+	for (i = 0; i < report->num; i++)
+		seq_printf(m, "%s: %u cmds %u xfers\n", report->names[i],
+			   report->sets[i].num_cmd, report->sets[i].num_xfers);
+
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(panel_google_cmd_set_xfers);
+
+/**
+ * panel_google_cmd_set_debugfs_init - report the packing of resolved command sets
+ * @dev: panel device
+ * @dir: debugfs directory of the panel
+ * @sets: resolved command sets
+ * @names: name of each entry in @sets
+ * @num: number of entries in @sets
+ *
+ * Creates "cmd_set_xfers", listing how many commands and DSI transfers each set has.
+ */
+static inline void panel_google_cmd_set_debugfs_init(struct device *dev, struct dentry *dir,
+						     const struct panel_google_cmd_set *sets,
+						     const char * const *names, u32 num)
+{
+	struct panel_google_cmd_set_report *report;
+
+	report = devm_kzalloc(dev, sizeof(*report), GFP_KERNEL);
+	if (!report)
+		return;
+
+	report->sets = sets;
+	report->names = names;
+	report->num = num;
+	debugfs_create_file("cmd_set_xfers", 0444, dir, report, &panel_google_cmd_set_xfers_fops);
+}
+
+#endif /* _PANEL_GOOGLE_COMMON_H_ */
@@ -11,14 +11,18 @@
 
 #include <drm/drm_vblank.h>
 #include <linux/debugfs.h>
+#include <linux/kthread.h>
 #include <linux/module.h>
 #include <linux/of_platform.h>
+#include <linux/seqlock.h>
+#include <linux/slab.h>
 #include <linux/thermal.h>
 #include <video/mipi_display.h>
 
 #include "include/trace/dpu_trace.h"
 #include "include/trace/panel_trace.h"
 #include "panel/panel-samsung-drv.h"
+#include "panel-google-common.h"
 
 /**
  * enum hk3_panel_feature - features supported by this panel
@@ -77,6 +81,7 @@ enum hk3_lhbm_brt_overdrive_group {
 	LHBM_OVERDRIVE_GRP_300_NIT,
 	LHBM_OVERDRIVE_GRP_MAX
 };
+static_assert(LHBM_OVERDRIVE_GRP_MAX == PANEL_GOOGLE_LHBM_OD_GRP_MAX);
 
 /**
  * enum hk3_material - different materials in HW
@@ -103,6 +108,10 @@ struct hk3_lhbm_ctl {
 	bool hist_roi_configured;
 };
 
+/* luminance model above the normal range */
+#define HK3_HBM_NITS_SLOPE 700
+#define HK3_HBM_NITS_OFFSET -1271
+
 #define HK3_VREG_STR_SIZE 11
 #define HK3_VREG_PARAM_NUM 5
 
@@ -116,6 +125,148 @@ struct hk3_lhbm_ctl {
  */
 #define HK3_VREG_STR(ctx) (((ctx)->panel_rev >= PANEL_REV_DVT1) ? "1a1a1a1a1a" : "1b1b1b1b1b")
 
+/**
+ * enum hk3_nolp_step - steps of the AOD exit sequence
+ * @NOLP_TE_SYNC: changeable TE at 30Hz is effective
+ * @NOLP_DISPLAY_OFF: display off is effective
+ * @NOLP_AOD_OFF: AOD off and normal mode settings are sent in one burst
+ * @NOLP_DISPLAY_ON: display on commands are sent
+ * @NOLP_STEP_MAX: placeholder, counter for number of steps
+ */
+enum hk3_nolp_step {
+	NOLP_TE_SYNC = 0,
+	NOLP_DISPLAY_OFF,
+	NOLP_AOD_OFF,
+	NOLP_DISPLAY_ON,
+	NOLP_STEP_MAX,
+};
+
+/**
+ * enum hk3_trans_type - panel transitions recorded for underrun correlation
+ * @TRANS_RR: refresh rate change through mode set
+ * @TRANS_RRS: resolution switch through mode set
+ * @TRANS_OP_HZ: operation rate switch between HS and NS
+ * @TRANS_IDLE_ENTER: entering self refresh idle
+ * @TRANS_IDLE_EXIT: exiting self refresh idle
+ * @TRANS_EARLY_EXIT: early exit or auto mode off on a new frame
+ * @TRANS_HBM: HBM mode change
+ * @TRANS_LP: entering AOD
+ * @TRANS_NOLP: exiting AOD
+ * @TRANS_MAX: placeholder, counter for number of transition types
+ */
+enum hk3_trans_type {
+	TRANS_RR = 0,
+	TRANS_RRS,
+	TRANS_OP_HZ,
+	TRANS_IDLE_ENTER,
+	TRANS_IDLE_EXIT,
+	TRANS_EARLY_EXIT,
+	TRANS_HBM,
+	TRANS_LP,
+	TRANS_NOLP,
+	TRANS_MAX,
+};
+
+/* number of latest transitions kept in the log */
+#define HK3_TRANS_LOG_SIZE 64
+/* duration histogram buckets: <1ms, <2ms, <4ms, <8ms, <16ms, <32ms, >=32ms */
+#define HK3_TRANS_HIST_SIZE 7
+
+/**
+ * struct hk3_trans_rec - record of one panel transition
+ * @start: time the transition started, same clock as the DPU underrun logs
+ * @dur_us: duration of the transition
+ * @type: &enum hk3_trans_type
+ * @vrefresh: refresh rate effective in panel after the transition
+ * @fixed_te: whether fixed TE is in effect after the transition
+ */
+struct hk3_trans_rec {
+	ktime_t start;
+	u32 dur_us;
+	u8 type;
+	u8 vrefresh;
+	bool fixed_te;
+};
+
+/**
+ * struct hk3_trans_log - ring of latest transitions and per type duration histogram
+ * @lock: protects the log against debugfs readers
+ * @rec: ring of the latest transitions
+ * @count: number of transitions recorded so far, the ring head is @count modulo size
+ * @hist: duration histogram for each transition type
+ */
+struct hk3_trans_log {
+	spinlock_t lock;
+	struct hk3_trans_rec rec[HK3_TRANS_LOG_SIZE];
+	u32 count;
+	u32 hist[TRANS_MAX][HK3_TRANS_HIST_SIZE];
+};
+
+/* command sets resolved for the panel revision, with transfer counts in debugfs */
+enum hk3_cmd_set_id {
+	CMD_SET_INIT,
+	CMD_SET_NS_GAMMA_FIX,
+	CMD_SET_DISPLAY_ON,
+	CMD_SET_DISPLAY_OFF,
+	CMD_SET_MAX,
+};
+
+#define HK3_READ_MAX_LEN 8
+
+/**
+ * struct hk3_read_req - asynchronous register read
+ * @work: work queued on the panel command worker
+ * @ctx: panel to read from
+ * @reg: register to read
+ * @offset: global para offset of the first byte to read
+ * @len: number of bytes to read
+ * @buf: data read back
+ * @ret: number of bytes read, or negative error code
+ * @done: completed after @complete returns
+ * @complete: called on the command worker with mode_lock held once the read finished
+ *
+ * A request can't be queued again before it completes, queuing a pending request has
+ * no effect so callers don't need to track it.
+ */
+struct hk3_read_req {
+	struct kthread_work work;
+	struct exynos_panel *ctx;
+	u8 reg;
+	u16 offset;
+	u8 len;
+	u8 buf[HK3_READ_MAX_LEN];
+	int ret;
+	struct completion done;
+	void (*complete)(struct exynos_panel *ctx, struct hk3_read_req *req);
+};
+
+/**
+ * struct hk3_hw_state - snapshot of the hw_ fields of struct hk3_panel
+ *
+ * Published after every committed transition so that telemetry readers can
+ * look at the panel state without taking the mode lock.
+ */
+struct hk3_hw_state {
+	/** @feat: correlated states effective in panel */
+	DECLARE_BITMAP(feat, FEAT_MAX);
+	/** @vrefresh: vrefresh rate of the mode effective in panel */
+	u32 vrefresh;
+	/** @hint_vrefresh: manual rate effective in panel due to a frame rate hint, 0 if none */
+	u32 hint_vrefresh;
+	/** @idle_vrefresh: idle vrefresh rate effective in panel */
+	u32 idle_vrefresh;
+	/** @temp: the temperature applied into panel */
+	u32 temp;
+	/** @dbv: the current dbv */
+	u16 dbv;
+	/** @acl_setting: automatic current limiting setting */
+	u8 acl_setting;
+	/** @za_enabled: whether zonal attenuation is enabled */
+	bool za_enabled;
+	/** @vreg: the Vreg setting read back from panel */
+	char vreg[HK3_VREG_STR_SIZE];
+};
+
 /**
  * struct hk3_panel - panel specific info
  *
@@ -130,8 +281,13 @@ struct hk3_panel {
 	DECLARE_BITMAP(feat, FEAT_MAX);
 	/** @hw_feat: correlated states effective in panel */
 	DECLARE_BITMAP(hw_feat, FEAT_MAX);
-	/** @hw_vrefresh: vrefresh rate effective in panel */
+	/** @hw_vrefresh: vrefresh rate of the mode effective in panel */
 	u32 hw_vrefresh;
+	/**
+	 * @hw_hint_vrefresh: manual rate effective in panel instead of @hw_vrefresh due to
+	 *		      @frame_rate_hint, 0 if none
+	 */
+	u32 hw_hint_vrefresh;
 	/** @hw_idle_vrefresh: idle vrefresh rate effective in panel */
 	u32 hw_idle_vrefresh;
 	/**
@@ -139,6 +295,19 @@ struct hk3_panel {
 	 *			if 0 it means that auto mode is not enabled
 	 */
 	u32 auto_mode_vrefresh;
+	/**
+	 * @frame_rate_hint: content frame rate requested by userspace, 0 if there's no hint.
+	 *		     Used to pick a lower manual refresh rate without a mode switch.
+	 */
+	u32 frame_rate_hint;
+	/** @hint_vrefresh: manual refresh rate applied due to @frame_rate_hint, 0 if none */
+	u32 hint_vrefresh;
+	/** @hw_te2_option: TE2 option effective in panel, 0 if unknown (e.g. after reset) */
+	u8 hw_te2_option;
+	/** @hw_te2_rising: TE2 rising edge effective in panel */
+	u32 hw_te2_rising;
+	/** @hw_te2_falling: TE2 falling edge effective in panel */
+	u32 hw_te2_falling;
 	/** @force_changeable_te: force changeable TE (instead of fixed) during early exit */
 	bool force_changeable_te;
 	/** @force_changeable_te2: force changeable TE (instead of fixed) for monitoring refresh rate */
@@ -147,12 +316,16 @@ struct hk3_panel {
 	u8 hw_acl_setting;
 	/** @hw_dbv: indicate the current dbv, will be zero after sleep in/out */
 	u16 hw_dbv;
+	/** @idle_floor_vrefresh: lowest flicker-safe idle refresh rate at @hw_dbv */
+	u32 idle_floor_vrefresh;
 	/** @hw_za_enabled: whether zonal attenuation is enabled */
 	bool hw_za_enabled;
 	/** @force_za_off: force to turn off zonal attenuation */
 	bool force_za_off;
 	/** @lhbm_ctl: lhbm brightness control */
 	struct hk3_lhbm_ctl lhbm_ctl;
+	/** @brt_lut: brightness lookup table indexed by DBV */
+	struct panel_google_brt_lut brt_lut;
 	/** @material: the material version used in panel */
 	enum hk3_material material;
 	/** @tz: thermal zone device for reading temperature */
@@ -164,6 +337,19 @@ struct hk3_panel {
 	 *                       handled in the commit_done function.
 	 */
 	bool pending_temp_update;
+	/** @idle_exit_ts: time the panel left self refresh idle, 0 once the next commit is done */
+	ktime_t idle_exit_ts;
+	/** @idle_exit_latency_us: time from the latest idle exit to the next commit done */
+	u32 idle_exit_latency_us;
+	/** @idle_exit_latency_max_us: worst @idle_exit_latency_us seen, writable to reset */
+	u32 idle_exit_latency_max_us;
+	/**
+	 * @maint_batch: a maintenance batch is open, see hk3_maint_begin(). Sequences queued
+	 *		 meanwhile share one unlock, flush and lock.
+	 */
+	bool maint_batch;
+	/** @maint_unlocked: unlock_cmd_f0 was already queued in the open maintenance batch */
+	bool maint_unlocked;
 	/**
 	 * @is_pixel_off: pixel-off command is sent to panel. Only sending normal-on or resetting
 	 *		  panel can recover to normal mode after entering pixel-off state.
@@ -177,10 +363,135 @@ struct hk3_panel {
 	 *	       cannot block the main thread.
 	 */
 	bool read_vreg;
+	/** @vreg_req: request to read back Vreg setting off the self refresh path */
+	struct hk3_read_req vreg_req;
+	/** @opr_req: request to read OPR for zonal attenuation */
+	struct hk3_read_req opr_req;
+	/** @pwr_on: timeline of the latest power on */
+	struct panel_google_pwr_on_timeline pwr_on;
+	/** @nolp_start: time the latest AOD exit started */
+	ktime_t nolp_start;
+	/** @nolp_us: time each AOD exit step finished, relative to @nolp_start */
+	s64 nolp_us[NOLP_STEP_MAX];
+	/** @req_dbv: the dbv requested by the brightness path, before any derating cap */
+	u16 req_dbv;
+	/** @derate_level: current index into hk3_therm_derate_table */
+	u8 derate_level;
+	/**
+	 * @derate_max_dbv: dbv cap applied due to disp_therm. It moves towards the cap of
+	 *		    @derate_level in steps, so the brightness change isn't noticeable.
+	 */
+	u16 derate_max_dbv;
+	/** @bcl: cooling device used by BCL to shed panel current */
+	struct panel_google_bcl bcl;
+	/**
+	 * @cmd_worker: high priority worker owned by this panel, deferred panel commands are
+	 *		queued here instead of the shared system workqueue
+	 */
+	struct kthread_worker *cmd_worker;
+	/** @hw_state_lock: protects @hw_state against torn reads */
+	seqlock_t hw_state_lock;
+	/** @hw_state: copy of the hw_ fields for readers not holding the mode lock */
+	struct hk3_hw_state hw_state;
+	/** @trans_log: log of panel transitions, see hk3_trans_begin() */
+	struct hk3_trans_log trans_log;
+	/** @cmd_sets: command sets resolved for the panel revision, see hk3_send_cmd_set() */
+	struct panel_google_cmd_set cmd_sets[CMD_SET_MAX];
 };
 
 #define to_spanel(ctx) container_of(ctx, struct hk3_panel, base)
 
+/**
+ * hk3_publish_hw_state - publish the hw_ fields after a committed transition
+ * @spanel: hk3 panel struct
+ */
+static void hk3_publish_hw_state(struct hk3_panel *spanel)
+{
+	struct hk3_hw_state *state = &spanel->hw_state;
+
+	write_seqlock(&spanel->hw_state_lock);
+	bitmap_copy(state->feat, spanel->hw_feat, FEAT_MAX);
+	state->vrefresh = spanel->hw_vrefresh;
+	state->hint_vrefresh = spanel->hw_hint_vrefresh;
+	state->idle_vrefresh = spanel->hw_idle_vrefresh;
+	state->temp = spanel->hw_temp;
+	state->dbv = spanel->hw_dbv;
+	state->acl_setting = spanel->hw_acl_setting;
+	state->za_enabled = spanel->hw_za_enabled;
+	memcpy(state->vreg, spanel->hw_vreg, sizeof(state->vreg));
+	write_sequnlock(&spanel->hw_state_lock);
+}
+
+/**
+ * hk3_get_hw_state - get a consistent copy of the published hw state
+ * @spanel: hk3 panel struct
+ * @state: filled with the latest published state
+ *
+ * This never waits for the commit path, it only retries if a publish raced with it.
+ */
+static void hk3_get_hw_state(struct hk3_panel *spanel, struct hk3_hw_state *state)
+{
+	unsigned int seq;
+
+	do {
+		seq = read_seqbegin(&spanel->hw_state_lock);
+		*state = spanel->hw_state;
+	} while (read_seqretry(&spanel->hw_state_lock, seq));
+}
+
+static const char * const hk3_trans_names[TRANS_MAX] = {
+	[TRANS_RR] = "hk3_trans_rr",
+	[TRANS_RRS] = "hk3_trans_rrs",
+	[TRANS_OP_HZ] = "hk3_trans_op_hz",
+	[TRANS_IDLE_ENTER] = "hk3_trans_idle_enter",
+	[TRANS_IDLE_EXIT] = "hk3_trans_idle_exit",
+	[TRANS_EARLY_EXIT] = "hk3_trans_early_exit",
+	[TRANS_HBM] = "hk3_trans_hbm",
+	[TRANS_LP] = "hk3_trans_lp",
+	[TRANS_NOLP] = "hk3_trans_nolp",
+};
+
+/**
+ * hk3_trans_begin - mark the start of a panel transition
+ * @type: &enum hk3_trans_type
+ *
+ * Transitions are traced and logged with their start time and the TE mode they leave
+ * in effect, so DPU underruns can be lined up with the panel operation behind them.
+ * Return: start time to be passed to hk3_trans_end()
+ */
+static ktime_t hk3_trans_begin(enum hk3_trans_type type)
+{
+	DPU_ATRACE_BEGIN(hk3_trans_names[type]);
+
+	return ktime_get();
+}
+
+static void hk3_trans_end(struct exynos_panel *ctx, enum hk3_trans_type type, ktime_t start)
+{
+	struct hk3_panel *spanel = to_spanel(ctx);
+	struct hk3_trans_log *log = &spanel->trans_log;
+	const u32 dur_us = ktime_us_delta(ktime_get(), start);
+	struct hk3_trans_rec *rec;
+	unsigned long flags;
+	int bucket;
+
+	DPU_ATRACE_END(hk3_trans_names[type]);
+
+	bucket = (dur_us < 1000) ? 0 : min(ilog2(dur_us / 1000) + 1, HK3_TRANS_HIST_SIZE - 1);
+
+	spin_lock_irqsave(&log->lock, flags);
+	rec = &log->rec[log->count % HK3_TRANS_LOG_SIZE];
+	rec->start = start;
+	rec->dur_us = dur_us;
+	rec->type = type;
+	/* a hinted manual rate overrides the mode rate in the panel */
+	rec->vrefresh = spanel->hw_hint_vrefresh ?: spanel->hw_vrefresh;
+	rec->fixed_te = test_bit(FEAT_EARLY_EXIT, spanel->hw_feat) && !spanel->force_changeable_te;
+	log->count++;
+	log->hist[type][bucket]++;
+	spin_unlock_irqrestore(&log->lock, flags);
+}
+
 /* 1344x2992 */
 static const struct drm_dsc_config wqhd_pps_config = {
 	.line_buf_depth = 9,
@@ -344,6 +655,69 @@ static const u8 aod_off[] = { MIPI_DCS_WRITE_CONTROL_DISPLAY, 0x20 };
 /* 50 nits */
 static const u8 aod_dbv[] = { MIPI_DCS_SET_DISPLAY_BRIGHTNESS, 0x03, 0x55 };
 
+/**
+ * hk3_maint_begin - open a maintenance batch
+ * @ctx: panel struct
+ *
+ * Deferred maintenance writes done at idle entry are each wrapped by their own unlock,
+ * flush and lock. Between hk3_maint_begin() and hk3_maint_end() they are queued in
+ * order behind a single unlock instead, and go out as one DSI burst.
+ */
+static void hk3_maint_begin(struct exynos_panel *ctx)
+{
+	struct hk3_panel *spanel = to_spanel(ctx);
+
+	spanel->maint_batch = true;
+	spanel->maint_unlocked = false;
+}
+
+static void hk3_maint_end(struct exynos_panel *ctx)
+{
+	struct hk3_panel *spanel = to_spanel(ctx);
+
+	if (!spanel->maint_batch)
+		return;
+
+	spanel->maint_batch = false;
+	if (spanel->maint_unlocked)
+		EXYNOS_DCS_BUF_ADD_SET_AND_FLUSH(ctx, lock_cmd_f0);
+}
+
+static void hk3_maint_unlock(struct exynos_panel *ctx)
+{
+	struct hk3_panel *spanel = to_spanel(ctx);
+
+	if (spanel->maint_batch) {
+		if (spanel->maint_unlocked)
+			return;
+		spanel->maint_unlocked = true;
+	}
+	EXYNOS_DCS_BUF_ADD_SET(ctx, unlock_cmd_f0);
+}
+
+static void hk3_maint_lock_and_flush(struct exynos_panel *ctx)
+{
+	if (to_spanel(ctx)->maint_batch)
+		return;
+
+	EXYNOS_DCS_BUF_ADD_SET_AND_FLUSH(ctx, lock_cmd_f0);
+}
+
+/**
+ * hk3_send_cmd_set - send a command set in as few DSI transfers as possible
+ * @ctx: panel struct
+ * @cmd_set: command set to send
+ * @id: slot of @cmd_set in &hk3_panel.cmd_sets
+ *
+ * Sends the copy of @cmd_set resolved for the panel revision by hk3_resolve_cmd_sets(),
+ * see panel_google_send_cmd_set().
+ */
+static void hk3_send_cmd_set(struct exynos_panel *ctx, const struct exynos_dsi_cmd_set *cmd_set,
+			     enum hk3_cmd_set_id id)
+{
+	panel_google_send_cmd_set(ctx, cmd_set, &to_spanel(ctx)->cmd_sets[id]);
+}
+
 static const struct exynos_dsi_cmd hk3_lp_low_cmds[] = {
 	EXYNOS_DSI_CMD0(unlock_cmd_f0),
 	/* AOD Low Mode, 10nit */
@@ -373,42 +747,65 @@ static inline bool is_in_comp_range(int temp)
 	return (temp >= 10 && temp <= 49);
 }
 
-/* Read temperature and apply appropriate gain into DDIC for burn-in compensation if needed */
-static void hk3_update_disp_therm(struct exynos_panel *ctx)
+/* Read disp_therm, in celsius */
+static int hk3_read_disp_therm(struct exynos_panel *ctx, int *temp)
 {
-	/* temperature*1000 in celsius */
-	int temp, ret;
 	struct hk3_panel *spanel = to_spanel(ctx);
+	int ret;
 
 	if (IS_ERR_OR_NULL(spanel->tz))
-		return;
+		return -ENODEV;
+
+	/* temperature*1000 in celsius */
+	ret = thermal_zone_get_temp(spanel->tz, temp);
+	if (ret) {
+		dev_err(ctx->dev, "%s: fail to read temperature ret:%d\n", __func__, ret);
+		return ret;
+	}
+	*temp = DIV_ROUND_CLOSEST(*temp, 1000);
+
+	return 0;
+}
 
-	if (ctx->panel_rev < PANEL_REV_EVT1_1 || ctx->panel_state != PANEL_STATE_NORMAL)
+static void hk3_update_therm_derating(struct exynos_panel *ctx, int temp);
+
+/*
+ * Read temperature, update the HBM derating and apply appropriate gain into DDIC for burn-in
+ * compensation if needed
+ */
+static void hk3_update_disp_therm(struct exynos_panel *ctx)
+{
+	int temp;
+	struct hk3_panel *spanel = to_spanel(ctx);
+
+	if (IS_ERR_OR_NULL(spanel->tz) || ctx->panel_state != PANEL_STATE_NORMAL)
 		return;
 
 	spanel->pending_temp_update = false;
 
-	ret = thermal_zone_get_temp(spanel->tz, &temp);
-	if (ret) {
-		dev_err(ctx->dev, "%s: fail to read temperature ret:%d\n", __func__, ret);
+	if (hk3_read_disp_therm(ctx, &temp))
 		return;
-	}
 
-	temp = DIV_ROUND_CLOSEST(temp, 1000);
 	dev_dbg(ctx->dev, "%s: temp=%d\n", __func__, temp);
+	hk3_update_therm_derating(ctx, temp);
+
+	if (ctx->panel_rev < PANEL_REV_EVT1_1)
+		return;
+
 	if (temp == spanel->hw_temp || !is_in_comp_range(temp))
 		return;
 
 	dev_dbg(ctx->dev, "%s: apply gain into ddic at %ddeg c\n", __func__, temp);
 
 	DPU_ATRACE_BEGIN(__func__);
-	EXYNOS_DCS_BUF_ADD_SET(ctx, unlock_cmd_f0);
+	hk3_maint_unlock(ctx);
 	EXYNOS_DCS_BUF_ADD(ctx, 0xB0, 0x00, 0x03, 0x67);
 	EXYNOS_DCS_BUF_ADD(ctx, 0x67, temp);
-	EXYNOS_DCS_BUF_ADD_SET_AND_FLUSH(ctx, lock_cmd_f0);
+	hk3_maint_lock_and_flush(ctx);
 	DPU_ATRACE_END(__func__);
 
 	spanel->hw_temp = temp;
+	hk3_publish_hw_state(spanel);
 }
 
 static u8 hk3_get_te2_option(struct exynos_panel *ctx)
@@ -461,6 +858,12 @@ static void hk3_update_te2_internal(struct exynos_panel *ctx, bool lock)
 
 	ctx->te2.option = (option == HK3_TE2_FIXED) ? TE2_OPT_FIXED : TE2_OPT_CHANGEABLE;
 
+	if (option == spanel->hw_te2_option && rising == spanel->hw_te2_rising &&
+	    falling == spanel->hw_te2_falling) {
+		dev_dbg(ctx->dev, "%s: no changes, skip update\n", __func__);
+		return;
+	}
+
 	dev_dbg(ctx->dev,
 		"TE2 updated: %s mode, option %s, idle %s, rising=0x%X falling=0x%X\n",
 		test_bit(FEAT_OP_NS, spanel->feat) ? "NS" : "HS",
@@ -487,6 +890,10 @@ static void hk3_update_te2_internal(struct exynos_panel *ctx, bool lock)
 	}
 	if (lock)
 		EXYNOS_DCS_BUF_ADD_SET_AND_FLUSH(ctx, lock_cmd_f0);
+
+	spanel->hw_te2_option = option;
+	spanel->hw_te2_rising = rising;
+	spanel->hw_te2_falling = falling;
 }
 
 static void hk3_update_te2(struct exynos_panel *ctx)
@@ -510,15 +917,43 @@ static inline bool is_auto_mode_allowed(struct exynos_panel *ctx)
 	return ctx->panel_idle_enabled;
 }
 
+/*
+ * Low refresh rate flicker is only visible at dim levels, so the idle rate floor depends on
+ * DBV. Bands are in ascending DBV order, the last one covers the rest of the range.
+ */
+static const struct {
+	u16 dbv_max;
+	u32 min_idle_vrefresh;
+} hk3_idle_floor_bands[] = {
+	{ .dbv_max = 299, .min_idle_vrefresh = 30 },
+	{ .dbv_max = 999, .min_idle_vrefresh = 10 },
+	{ .dbv_max = 4095, .min_idle_vrefresh = 1 },
+};
+
+static u32 hk3_get_idle_floor(u16 dbv)
+{
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(hk3_idle_floor_bands) - 1; i++) {
+		if (dbv <= hk3_idle_floor_bands[i].dbv_max)
+			break;
+	}
+
+	return hk3_idle_floor_bands[i].min_idle_vrefresh;
+}
+
 static u32 hk3_get_min_idle_vrefresh(struct exynos_panel *ctx,
 				     const struct exynos_panel_mode *pmode)
 {
+	const struct hk3_panel *spanel = to_spanel(ctx);
 	const int vrefresh = drm_mode_vrefresh(&pmode->mode);
 	int min_idle_vrefresh = ctx->min_vrefresh;
 
 	if ((min_idle_vrefresh < 0) || !is_auto_mode_allowed(ctx))
 		return 0;
 
+	min_idle_vrefresh = max_t(int, min_idle_vrefresh, spanel->idle_floor_vrefresh);
+
 	if (min_idle_vrefresh <= 1)
 		min_idle_vrefresh = 1;
 	else if (min_idle_vrefresh <= 10)
@@ -534,15 +969,18 @@ static u32 hk3_get_min_idle_vrefresh(struct exynos_panel *ctx,
 		return 0;
 	}
 
-	dev_dbg(ctx->dev, "%s: min_idle_vrefresh %d\n", __func__, min_idle_vrefresh);
+	dev_dbg(ctx->dev, "%s: min_idle_vrefresh %d (dbv floor %u)\n", __func__,
+		min_idle_vrefresh, spanel->idle_floor_vrefresh);
 
 	return min_idle_vrefresh;
 }
 
-static void hk3_set_panel_feat(struct exynos_panel *ctx,
-	const u32 vrefresh, const u32 idle_vrefresh, const unsigned long *feat, bool enforce)
+static void hk3_set_panel_feat(struct exynos_panel *ctx, const u32 mode_vrefresh,
+	const u32 hint_vrefresh, const u32 idle_vrefresh, const unsigned long *feat, bool enforce)
 {
 	struct hk3_panel *spanel = to_spanel(ctx);
+	/* manual rate programmed in panel */
+	const u32 vrefresh = hint_vrefresh ? hint_vrefresh : mode_vrefresh;
 	u8 val;
 	DECLARE_BITMAP(changed_feat, FEAT_MAX);
 
@@ -551,14 +989,16 @@ static void hk3_set_panel_feat(struct exynos_panel *ctx,
 	} else {
 		bitmap_xor(changed_feat, feat, spanel->hw_feat, FEAT_MAX);
 		if (bitmap_empty(changed_feat, FEAT_MAX) &&
-			vrefresh == spanel->hw_vrefresh &&
+			mode_vrefresh == spanel->hw_vrefresh &&
+			hint_vrefresh == spanel->hw_hint_vrefresh &&
 			idle_vrefresh == spanel->hw_idle_vrefresh) {
 			dev_dbg(ctx->dev, "%s: no changes, skip update\n", __func__);
 			return;
 		}
 	}
 
-	spanel->hw_vrefresh = vrefresh;
+	spanel->hw_vrefresh = mode_vrefresh;
+	spanel->hw_hint_vrefresh = hint_vrefresh;
 	spanel->hw_idle_vrefresh = idle_vrefresh;
 	bitmap_copy(spanel->hw_feat, feat, FEAT_MAX);
 	dev_dbg(ctx->dev,
@@ -573,7 +1013,7 @@ static void hk3_set_panel_feat(struct exynos_panel *ctx,
 		vrefresh,
 		idle_vrefresh);
 
-	EXYNOS_DCS_BUF_ADD_SET(ctx, unlock_cmd_f0);
+	hk3_maint_unlock(ctx);
 
 	/* TE setting */
 	if (test_bit(FEAT_EARLY_EXIT, changed_feat) ||
@@ -853,7 +1293,9 @@ static void hk3_set_panel_feat(struct exynos_panel *ctx,
 	}
 
 	EXYNOS_DCS_BUF_ADD_SET(ctx, freq_update);
-	EXYNOS_DCS_BUF_ADD_SET_AND_FLUSH(ctx, lock_cmd_f0);;
+	hk3_maint_lock_and_flush(ctx);
+
+	hk3_publish_hw_state(spanel);
 }
 
 /**
@@ -867,22 +1309,52 @@ static void hk3_disable_panel_feat(struct exynos_panel *ctx, u32 vrefresh)
 	DECLARE_BITMAP(feat, FEAT_MAX);
 
 	bitmap_zero(feat, FEAT_MAX);
-	hk3_set_panel_feat(ctx, vrefresh, 0, feat, true);
+	hk3_set_panel_feat(ctx, vrefresh, 0, 0, feat, true);
 }
 
 static void hk3_update_panel_feat(struct exynos_panel *ctx, u32 vrefresh, bool enforce)
 {
 	struct hk3_panel *spanel = to_spanel(ctx);
 
-	hk3_set_panel_feat(ctx, vrefresh, spanel->auto_mode_vrefresh, spanel->feat, enforce);
+	/* stay at the rate picked for the content frame rate hint */
+	hk3_set_panel_feat(ctx, vrefresh, spanel->hint_vrefresh, spanel->auto_mode_vrefresh,
+			   spanel->feat, enforce);
+}
+
+/*
+ * Get the lowest manual refresh rate that is a multiple of the content frame rate hint, so
+ * every content frame is shown for the same number of panel frames. Returns 0 if the hint
+ * doesn't allow going below the mode refresh rate.
+ */
+static u32 hk3_get_hint_vrefresh(struct exynos_panel *ctx, u32 vrefresh)
+{
+	static const u32 manual_rates[] = { 1, 5, 10, 30, 60, 120 };
+	struct hk3_panel *spanel = to_spanel(ctx);
+	const u32 hint = spanel->frame_rate_hint;
+	int i;
+
+	/* nothing is shown in fast blank, hold the lowest manual rate */
+	if (spanel->is_pixel_off)
+		return manual_rates[0] < vrefresh ? manual_rates[0] : 0;
+
+	if (!hint || hint >= vrefresh)
+		return 0;
+
+	for (i = 0; i < ARRAY_SIZE(manual_rates) && manual_rates[i] < vrefresh; i++) {
+		if (manual_rates[i] >= hint && !(manual_rates[i] % hint))
+			return manual_rates[i];
+	}
+
+	return 0;
 }
 
 static void hk3_update_refresh_mode(struct exynos_panel *ctx,
 					const struct exynos_panel_mode *pmode,
-					const u32 idle_vrefresh)
+					u32 idle_vrefresh)
 {
 	struct hk3_panel *spanel = to_spanel(ctx);
 	u32 vrefresh = drm_mode_vrefresh(&pmode->mode);
+	const u32 hint_vrefresh = hk3_get_hint_vrefresh(ctx, vrefresh);
 
 	/*
 	 * Skip idle update if going through RRS without refresh rate change. If
@@ -895,15 +1367,19 @@ static void hk3_update_refresh_mode(struct exynos_panel *ctx,
 		return;
 	}
 
-	dev_dbg(ctx->dev, "%s: mode: %s set idle_vrefresh: %u\n", __func__,
-		pmode->mode.name, idle_vrefresh);
+	/* content cadence is known, stay in manual mode at the hinted rate */
+	if (hint_vrefresh)
+		idle_vrefresh = 0;
+
+	dev_dbg(ctx->dev, "%s: mode: %s set idle_vrefresh: %u hint_vrefresh: %u\n", __func__,
+		pmode->mode.name, idle_vrefresh, hint_vrefresh);
 
 	if (idle_vrefresh)
 		set_bit(FEAT_FRAME_AUTO, spanel->feat);
 	else
 		clear_bit(FEAT_FRAME_AUTO, spanel->feat);
 
-	if (vrefresh == 120 || idle_vrefresh)
+	if (vrefresh == 120 || idle_vrefresh || hint_vrefresh)
 		set_bit(FEAT_EARLY_EXIT, spanel->feat);
 	else
 		clear_bit(FEAT_EARLY_EXIT, spanel->feat);
@@ -917,6 +1393,7 @@ static void hk3_update_refresh_mode(struct exynos_panel *ctx,
 	 * new frame commit will correct it if the guess is wrong.
 	 */
 	ctx->panel_idle_vrefresh = idle_vrefresh;
+	spanel->hint_vrefresh = hint_vrefresh;
 	hk3_update_panel_feat(ctx, vrefresh, false);
 
 	schedule_work(&ctx->state_notify);
@@ -945,6 +1422,43 @@ static void hk3_change_frequency(struct exynos_panel *ctx,
 	dev_dbg(ctx->dev, "change to %u hz\n", vrefresh);
 }
 
+/*
+ * Apply the idle rate floor of the current DBV. If the panel is already idling, or set up to
+ * idle on inactivity, at a rate the new floor doesn't allow (or could now go lower), update the
+ * refresh mode right away. Otherwise the floor takes effect on the next idle entry.
+ */
+static void hk3_update_idle_floor(struct exynos_panel *ctx)
+{
+	struct hk3_panel *spanel = to_spanel(ctx);
+	const struct exynos_panel_mode *pmode = ctx->current_mode;
+	const u32 floor = hk3_get_idle_floor(spanel->hw_dbv);
+	u32 idle_vrefresh, cur_idle_vrefresh;
+
+	if (floor == spanel->idle_floor_vrefresh)
+		return;
+
+	dev_dbg(ctx->dev, "%s: dbv %u idle floor %u -> %u hz\n", __func__,
+		spanel->hw_dbv, spanel->idle_floor_vrefresh, floor);
+	spanel->idle_floor_vrefresh = floor;
+
+	if (!pmode || pmode->exynos_mode.is_lp_mode || ctx->panel_state != PANEL_STATE_NORMAL)
+		return;
+
+	if (pmode->idle_mode == IDLE_MODE_ON_INACTIVITY)
+		cur_idle_vrefresh = spanel->auto_mode_vrefresh;
+	else if (pmode->idle_mode == IDLE_MODE_ON_SELF_REFRESH && ctx->panel_idle_vrefresh)
+		cur_idle_vrefresh = ctx->panel_idle_vrefresh;
+	else
+		return;
+
+	idle_vrefresh = hk3_get_min_idle_vrefresh(ctx, pmode);
+	/* manual mode is held for a hint or pixel off, see hk3_update_refresh_mode() */
+	if (hk3_get_hint_vrefresh(ctx, drm_mode_vrefresh(&pmode->mode)))
+		idle_vrefresh = 0;
+	if (idle_vrefresh != cur_idle_vrefresh)
+		hk3_update_refresh_mode(ctx, pmode, idle_vrefresh);
+}
+
 static void hk3_panel_idle_notification(struct exynos_panel *ctx,
 		u32 display_id, u32 vrefresh, u32 idle_te_vrefresh)
 {
@@ -984,27 +1498,91 @@ static void hk3_wait_one_vblank(struct exynos_panel *ctx)
 	DPU_ATRACE_END(__func__);
 }
 
-static void hk3_read_back_vreg(struct exynos_panel *ctx)
+/*
+ * After exiting idle with fixed TE, TE may keep running at 120hz for a while. That only
+ * matters if the mode isn't 120hz, otherwise TE already matches what DPU expects.
+ * @fixed_te is the TE state of the panel before the idle exit was sent.
+ */
+static bool hk3_idle_exit_needs_vblank(const struct exynos_panel_mode *pmode, bool fixed_te)
 {
-	struct hk3_panel *spanel = to_spanel(ctx);
+	return fixed_te && drm_mode_vrefresh(&pmode->mode) != 120;
+}
+
+static void hk3_read_work(struct kthread_work *work)
+{
+	struct hk3_read_req *req = container_of(work, struct hk3_read_req, work);
+	struct exynos_panel *ctx = req->ctx;
 	struct mipi_dsi_device *dsi = to_mipi_dsi_device(ctx->dev);
-	char buf[HK3_VREG_PARAM_NUM] = {0};
-	int ret;
 
-	EXYNOS_DCS_BUF_ADD_SET(ctx, unlock_cmd_f0);
-	EXYNOS_DCS_BUF_ADD_AND_FLUSH(ctx, 0xB0, 0x00, 0x31, 0xF4);
-	ret = mipi_dsi_dcs_read(dsi, 0xF4, buf, HK3_VREG_PARAM_NUM);
-	EXYNOS_DCS_BUF_ADD_SET_AND_FLUSH(ctx, lock_cmd_f0);
-	if (ret != HK3_VREG_PARAM_NUM) {
-		dev_warn(ctx->dev, "unable to read vreg setting (%d)\n", ret);
+	mutex_lock(&ctx->mode_lock);
+	if (ctx->panel_state != PANEL_STATE_NORMAL) {
+		req->ret = -EAGAIN;
 	} else {
-		exynos_bin2hex(buf, HK3_VREG_PARAM_NUM,
+		DPU_ATRACE_BEGIN(__func__);
+		EXYNOS_DCS_BUF_ADD_SET(ctx, unlock_cmd_f0);
+		EXYNOS_DCS_BUF_ADD_AND_FLUSH(ctx, 0xB0, req->offset >> 8, req->offset & 0xFF,
+					     req->reg);
+		req->ret = mipi_dsi_dcs_read(dsi, req->reg, req->buf, req->len);
+		EXYNOS_DCS_BUF_ADD_SET_AND_FLUSH(ctx, lock_cmd_f0);
+		DPU_ATRACE_END(__func__);
+	}
+	if (req->complete)
+		req->complete(ctx, req);
+	mutex_unlock(&ctx->mode_lock);
+
+	complete_all(&req->done);
+}
+
+static void hk3_init_read_req(struct exynos_panel *ctx, struct hk3_read_req *req, u8 reg,
+			      u16 offset, u8 len,
+			      void (*complete)(struct exynos_panel *, struct hk3_read_req *))
+{
+	kthread_init_work(&req->work, hk3_read_work);
+	init_completion(&req->done);
+	complete_all(&req->done);
+	req->ctx = ctx;
+	req->reg = reg;
+	req->offset = offset;
+	req->len = min_t(u8, len, HK3_READ_MAX_LEN);
+	req->complete = complete;
+}
+
+/*
+ * Queue a read on the panel command worker and return right away. The result is passed to
+ * the request's complete callback, or can be waited for with req->done when the caller
+ * doesn't hold mode_lock.
+ */
+static void hk3_read_async(struct exynos_panel *ctx, struct hk3_read_req *req)
+{
+	struct hk3_panel *spanel = to_spanel(ctx);
+
+	if (!completion_done(&req->done))
+		return;
+
+	reinit_completion(&req->done);
+	req->ret = 0;
+	if (!kthread_queue_work(spanel->cmd_worker, &req->work))
+		complete_all(&req->done);
+}
+
+static void hk3_vreg_read_done(struct exynos_panel *ctx, struct hk3_read_req *req)
+{
+	struct hk3_panel *spanel = to_spanel(ctx);
+
+	if (req->ret == -EAGAIN)
+		return;
+
+	if (req->ret != HK3_VREG_PARAM_NUM) {
+		dev_warn(ctx->dev, "unable to read vreg setting (%d)\n", req->ret);
+	} else {
+		exynos_bin2hex(req->buf, HK3_VREG_PARAM_NUM,
 			       spanel->hw_vreg, sizeof(spanel->hw_vreg));
 		if (!strcmp(spanel->hw_vreg, HK3_VREG_STR(ctx)))
 			dev_dbg(ctx->dev, "normal vreg: %s\n", spanel->hw_vreg);
 		else
 			dev_warn(ctx->dev, "abnormal vreg: %s (expect %s)\n",
 				 spanel->hw_vreg, HK3_VREG_STR(ctx));
+		hk3_publish_hw_state(spanel);
 	}
 
 	spanel->read_vreg = false;
@@ -1014,7 +1592,10 @@ static bool hk3_set_self_refresh(struct exynos_panel *ctx, bool enable)
 {
 	const struct exynos_panel_mode *pmode = ctx->current_mode;
 	struct hk3_panel *spanel = to_spanel(ctx);
+	enum hk3_trans_type trans_type;
+	ktime_t trans_start;
 	u32 idle_vrefresh;
+	bool fixed_te;
 
 	dev_dbg(ctx->dev, "%s: %d\n", __func__, enable);
 
@@ -1022,7 +1603,7 @@ static bool hk3_set_self_refresh(struct exynos_panel *ctx, bool enable)
 		return false;
 
 	if (enable && spanel->read_vreg)
-		hk3_read_back_vreg(ctx);
+		hk3_read_async(ctx, &spanel->vreg_req);
 
 	/* self refresh is not supported in lp mode since that always makes use of early exit */
 	if (pmode->exynos_mode.is_lp_mode) {
@@ -1032,10 +1613,18 @@ static bool hk3_set_self_refresh(struct exynos_panel *ctx, bool enable)
 		return false;
 	}
 
+	/* the temperature gain and refresh mode update go out in one burst */
+	hk3_maint_begin(ctx);
 	if (spanel->pending_temp_update && enable)
 		hk3_update_disp_therm(ctx);
 
 	idle_vrefresh = hk3_get_min_idle_vrefresh(ctx, pmode);
+	/*
+	 * hk3_update_refresh_mode() holds manual mode for a hint or pixel off, compare against
+	 * what it would apply so no idle entry is notified or logged meanwhile
+	 */
+	if (hk3_get_hint_vrefresh(ctx, drm_mode_vrefresh(&pmode->mode)))
+		idle_vrefresh = 0;
 
 	if (pmode->idle_mode != IDLE_MODE_ON_SELF_REFRESH) {
 		/*
@@ -1045,8 +1634,10 @@ static bool hk3_set_self_refresh(struct exynos_panel *ctx, bool enable)
 		if ((pmode->idle_mode == IDLE_MODE_ON_INACTIVITY) &&
 			(spanel->auto_mode_vrefresh != idle_vrefresh)) {
 			hk3_update_refresh_mode(ctx, pmode, idle_vrefresh);
+			hk3_maint_end(ctx);
 			return true;
 		}
+		hk3_maint_end(ctx);
 		return false;
 	}
 
@@ -1054,26 +1645,37 @@ static bool hk3_set_self_refresh(struct exynos_panel *ctx, bool enable)
 		idle_vrefresh = 0;
 
 	/* if there's no change in idle state then skip cmds */
-	if (ctx->panel_idle_vrefresh == idle_vrefresh)
+	if (ctx->panel_idle_vrefresh == idle_vrefresh) {
+		hk3_maint_end(ctx);
 		return false;
+	}
 
 	DPU_ATRACE_BEGIN(__func__);
+	trans_type = idle_vrefresh ? TRANS_IDLE_ENTER : TRANS_IDLE_EXIT;
+	trans_start = hk3_trans_begin(trans_type);
+	/* the refresh mode update below clears early exit on idle exit, record TE before it */
+	fixed_te = test_bit(FEAT_EARLY_EXIT, spanel->hw_feat) && !spanel->force_changeable_te;
 	hk3_update_refresh_mode(ctx, pmode, idle_vrefresh);
+	hk3_maint_end(ctx);
 
 	if (idle_vrefresh) {
 		const int vrefresh = drm_mode_vrefresh(&pmode->mode);
 
 		hk3_panel_idle_notification(ctx, 0, vrefresh, 120);
-	} else if (ctx->panel_need_handle_idle_exit) {
+	} else {
+		spanel->idle_exit_ts = ktime_get();
 		/*
 		 * after exit idle mode with fixed TE at non-120hz, TE may still keep at 120hz.
 		 * If any layer that already be assigned to DPU that can't be handled at 120hz,
 		 * panel_need_handle_idle_exit will be set then we need to wait one vblank to
 		 * avoid underrun issue.
 		 */
-		dev_dbg(ctx->dev, "wait one vblank after exit idle\n");
-		hk3_wait_one_vblank(ctx);
+		if (ctx->panel_need_handle_idle_exit && hk3_idle_exit_needs_vblank(pmode, fixed_te)) {
+			dev_dbg(ctx->dev, "wait one vblank after exit idle\n");
+			hk3_wait_one_vblank(ctx);
+		}
 	}
+	hk3_trans_end(ctx, trans_type, trans_start);
 
 	DPU_ATRACE_END(__func__);
 
@@ -1151,12 +1753,17 @@ static int hk3_atomic_check(struct exynos_panel *ctx, struct drm_atomic_state *s
 	return 0;
 }
 
-static void hk3_write_display_mode(struct exynos_panel *ctx,
-				   const struct drm_display_mode *mode)
+/* HBM requested by userspace and not held off by BCL mitigation */
+static inline bool hk3_is_hbm_on(struct exynos_panel *ctx)
+{
+	return IS_HBM_ON(ctx->hbm_mode) && !to_spanel(ctx)->bcl.state;
+}
+
+static u8 hk3_get_wrctrld(struct exynos_panel *ctx)
 {
 	u8 val = HK3_WRCTRLD_BCTRL_BIT;
 
-	if (IS_HBM_ON(ctx->hbm_mode))
+	if (hk3_is_hbm_on(ctx))
 		val |= HK3_WRCTRLD_HBM_BIT;
 
 	if (ctx->hbm.local_hbm.enabled)
@@ -1165,9 +1772,17 @@ static void hk3_write_display_mode(struct exynos_panel *ctx,
 	if (ctx->dimming_on)
 		val |= HK3_WRCTRLD_DIMMING_BIT;
 
+	return val;
+}
+
+static void hk3_write_display_mode(struct exynos_panel *ctx,
+				   const struct drm_display_mode *mode)
+{
+	u8 val = hk3_get_wrctrld(ctx);
+
 	dev_dbg(ctx->dev,
 		"%s(wrctrld:0x%x, hbm: %s, dimming: %s local_hbm: %s)\n",
-		__func__, val, IS_HBM_ON(ctx->hbm_mode) ? "on" : "off",
+		__func__, val, hk3_is_hbm_on(ctx) ? "on" : "off",
 		ctx->dimming_on ? "on" : "off",
 		ctx->hbm.local_hbm.enabled ? "on" : "off");
 
@@ -1177,49 +1792,26 @@ static void hk3_write_display_mode(struct exynos_panel *ctx,
 #define HK3_OPR_VAL_LEN 2
 #define HK3_MAX_OPR_VAL 0x3FF
 /* Get OPR (on pixel ratio), the unit is percent */
-static int hk3_get_opr(struct exynos_panel *ctx, u8 *opr)
+static int hk3_get_opr(struct hk3_read_req *req, u8 *opr)
 {
-	struct mipi_dsi_device *dsi = to_mipi_dsi_device(ctx->dev);
-	u8 buf[HK3_OPR_VAL_LEN] = {0};
 	u16 val;
-	int ret;
 
-	DPU_ATRACE_BEGIN(__func__);
-	EXYNOS_DCS_WRITE_TABLE(ctx, unlock_cmd_f0);
-	EXYNOS_DCS_WRITE_SEQ(ctx, 0xB0, 0x00, 0xE7, 0x91);
-	ret = mipi_dsi_dcs_read(dsi, 0x91, buf, HK3_OPR_VAL_LEN);
-	EXYNOS_DCS_WRITE_TABLE(ctx, lock_cmd_f0);
-	DPU_ATRACE_END(__func__);
-
-	if (ret != HK3_OPR_VAL_LEN) {
-		dev_warn(ctx->dev, "Failed to read OPR (%d)\n", ret);
-		return ret;
+	if (req->ret != HK3_OPR_VAL_LEN) {
+		dev_warn(req->ctx->dev, "Failed to read OPR (%d)\n", req->ret);
+		return req->ret < 0 ? req->ret : -EIO;
 	}
 
-	val = (buf[0] << 8) | buf[1];
+	val = (req->buf[0] << 8) | req->buf[1];
 	*opr = DIV_ROUND_CLOSEST(val * 100, HK3_MAX_OPR_VAL);
-	dev_dbg(ctx->dev, "%s: %u (0x%X)\n", __func__, *opr, val);
+	dev_dbg(req->ctx->dev, "%s: %u (0x%X)\n", __func__, *opr, val);
 
 	return 0;
 }
 
 #define HK3_ZA_THRESHOLD_OPR 80
-static void hk3_update_za(struct exynos_panel *ctx)
+static void hk3_set_za(struct exynos_panel *ctx, bool enable_za)
 {
 	struct hk3_panel *spanel = to_spanel(ctx);
-	bool enable_za = false;
-	u8 opr;
-
-	if ((spanel->hw_acl_setting > 0) && !spanel->force_za_off) {
-		if (ctx->panel_rev != PANEL_REV_PROTO1) {
-			enable_za = true;
-		} else if (!hk3_get_opr(ctx, &opr)) {
-			enable_za = (opr > HK3_ZA_THRESHOLD_OPR);
-		} else {
-			dev_warn(ctx->dev, "Unable to update za\n");
-			return;
-		}
-	}
 
 	if (spanel->hw_za_enabled != enable_za) {
 		/* LP setting - 0x21 or 0x11: 7.5%, 0x00: off */
@@ -1232,9 +1824,86 @@ static void hk3_update_za(struct exynos_panel *ctx)
 		EXYNOS_DCS_BUF_ADD(ctx, 0x92, val);
 		EXYNOS_DCS_BUF_ADD_SET_AND_FLUSH(ctx, lock_cmd_f0);
 
-		spanel->hw_za_enabled = enable_za;
-		dev_info(ctx->dev, "%s: %s\n", __func__, enable_za ? "on" : "off");
-	}
+		spanel->hw_za_enabled = enable_za;
+		hk3_publish_hw_state(spanel);
+		dev_info(ctx->dev, "%s: %s\n", __func__, enable_za ? "on" : "off");
+	}
+}
+
+static bool hk3_za_allowed(struct exynos_panel *ctx)
+{
+	struct hk3_panel *spanel = to_spanel(ctx);
+
+	return (spanel->hw_acl_setting > 0) && !spanel->force_za_off;
+}
+
+static void hk3_opr_read_done(struct exynos_panel *ctx, struct hk3_read_req *req)
+{
+	u8 opr;
+
+	/* ACL may have changed while the read was pending */
+	if (!hk3_za_allowed(ctx)) {
+		hk3_set_za(ctx, false);
+		return;
+	}
+
+	if (hk3_get_opr(req, &opr)) {
+		dev_warn(ctx->dev, "Unable to update za\n");
+		return;
+	}
+
+	hk3_set_za(ctx, opr > HK3_ZA_THRESHOLD_OPR);
+}
+
+static void hk3_update_za(struct exynos_panel *ctx)
+{
+	struct hk3_panel *spanel = to_spanel(ctx);
+
+	if (hk3_za_allowed(ctx) && ctx->panel_rev == PANEL_REV_PROTO1) {
+		/* decided by OPR once it's read back, without blocking the brightness path */
+		hk3_read_async(ctx, &spanel->opr_req);
+		return;
+	}
+
+	hk3_set_za(ctx, hk3_za_allowed(ctx));
+}
+
+/**
+ * struct hk3_therm_derate - HBM derating level driven by disp_therm
+ * @temp: temperature (in celsius) at which this level is entered
+ * @max_dbv: maximum dbv allowed in this level
+ * @min_acl: minimum ACL setting used in HBM in this level, EVT1 and later only
+ */
+struct hk3_therm_derate {
+	int temp;
+	u16 max_dbv;
+	u8 min_acl;
+};
+
+#define HK3_DERATE_MAX_DBV 4095
+#define HK3_NORMAL_MAX_DBV 3307
+/* a level is left once the temperature drops this much below its entry point */
+#define HK3_DERATE_HYST_DEG 3
+/* largest dbv increase applied at one evaluation when restoring */
+#define HK3_DERATE_DBV_STEP 128
+
+static const struct hk3_therm_derate hk3_therm_derate_table[] = {
+	{ .temp = INT_MIN, .max_dbv = HK3_DERATE_MAX_DBV, .min_acl = 0x00 },
+	{ .temp = 45, .max_dbv = 3900, .min_acl = 0x01 },
+	{ .temp = 48, .max_dbv = 3600, .min_acl = 0x02 },
+	{ .temp = 52, .max_dbv = HK3_NORMAL_MAX_DBV, .min_acl = 0x03 },
+};
+
+/*
+ * While BCL mitigates, dbv is capped as on the other panels by
+ * panel_google_bcl_brt_cap_max_dbv(), HBM and IRC flat Z mode are turned off, and the ACL
+ * setting is raised to 17% (EVT1 and later).
+ */
+#define HK3_BCL_MIN_ACL 0x03
+
+static inline u16 hk3_get_max_dbv(struct hk3_panel *spanel)
+{
+	return min(spanel->derate_max_dbv, spanel->bcl.max_dbv);
 }
 
 #define HK3_ACL_ZA_THRESHOLD_DBV_P1_0 3917
@@ -1291,9 +1960,22 @@ static void hk3_set_acl_mode(struct exynos_panel *ctx, enum exynos_acl_mode mode
 	if (enable_acl == false)
 		setting = 0;
 
+	/* raise ACL while HBM is derated due to temperature, or while BCL is mitigating */
+	if (ctx->panel_rev >= PANEL_REV_EVT1 && mode != ACL_OFF) {
+		u8 min_acl = 0;
+
+		if (IS_HBM_ON(ctx->hbm_mode))
+			min_acl = hk3_therm_derate_table[spanel->derate_level].min_acl;
+		if (spanel->bcl.state)
+			min_acl = max_t(u8, min_acl, HK3_BCL_MIN_ACL);
+		if (setting < min_acl)
+			setting = min_acl;
+	}
+
 	if (spanel->hw_acl_setting != setting) {
 		EXYNOS_DCS_WRITE_SEQ(ctx, 0x55, setting);
 		spanel->hw_acl_setting = setting;
+		hk3_publish_hw_state(spanel);
 		dev_info(ctx->dev, "%s: %d\n", __func__, setting);
 		/* Keep ZA off after EVT1 */
 		if (ctx->panel_rev < PANEL_REV_EVT1)
@@ -1301,6 +1983,65 @@ static void hk3_set_acl_mode(struct exynos_panel *ctx, enum exynos_acl_mode mode
 	}
 }
 
+static const struct exynos_dsi_cmd hk3_display_on_cmds[] = {
+	EXYNOS_DSI_CMD0(unlock_cmd_f0),
+	EXYNOS_DSI_CMD0(sync_begin),
+	/* AMP type change (return) */
+	EXYNOS_DSI_CMD_SEQ(0xB0, 0x00, 0x4F, 0xF4),
+	EXYNOS_DSI_CMD_SEQ(0xF4, 0x70),
+	/* Vreg = 7.1V (return) */
+	EXYNOS_DSI_CMD_SEQ(0xB0, 0x00, 0x31, 0xF4),
+	EXYNOS_DSI_CMD_SEQ_REV(PANEL_REV_GE(PANEL_REV_DVT1), 0xF4, 0x1A, 0x1A, 0x1A, 0x1A, 0x1A),
+	EXYNOS_DSI_CMD_SEQ_REV(PANEL_REV_LT(PANEL_REV_DVT1), 0xF4, 0x1B, 0x1B, 0x1B, 0x1B, 0x1B),
+	EXYNOS_DSI_CMD0(sync_end),
+	EXYNOS_DSI_CMD0(lock_cmd_f0),
+
+	EXYNOS_DSI_CMD_SEQ(MIPI_DCS_SET_DISPLAY_ON),
+};
+static DEFINE_EXYNOS_CMD_SET(hk3_display_on);
+
+static const struct exynos_dsi_cmd hk3_display_off_cmds[] = {
+	EXYNOS_DSI_CMD_SEQ(MIPI_DCS_SET_DISPLAY_OFF),
+
+	EXYNOS_DSI_CMD0(unlock_cmd_f0),
+	EXYNOS_DSI_CMD0(sync_begin),
+	/* AMP type change */
+	EXYNOS_DSI_CMD_SEQ(0xB0, 0x00, 0x4F, 0xF4),
+	EXYNOS_DSI_CMD_SEQ(0xF4, 0x50),
+	/* Vreg = 4.5 */
+	EXYNOS_DSI_CMD_SEQ(0xB0, 0x00, 0x31, 0xF4),
+	EXYNOS_DSI_CMD_SEQ(0xF4, 0x00, 0x00, 0x00, 0x00, 0x00),
+	EXYNOS_DSI_CMD0(sync_end),
+	EXYNOS_DSI_CMD0(lock_cmd_f0),
+};
+static DEFINE_EXYNOS_CMD_SET(hk3_display_off);
+
+/*
+ * Brightness 0 is shown by pixel off with the panel kept on (fast blank), so short blanks such
+ * as proximity during a call wake with a single normal mode command instead of a full power
+ * on. The panel holds its lowest manual refresh rate meanwhile. Longer blanks are powered off
+ * through the regular DRM blank path.
+ */
+static void hk3_fast_blank_enter(struct exynos_panel *ctx)
+{
+	struct hk3_panel *spanel = to_spanel(ctx);
+
+	EXYNOS_DCS_WRITE_TABLE(ctx, pixel_off);
+	spanel->is_pixel_off = true;
+	/* picks the lowest manual rate through hk3_get_hint_vrefresh() */
+	hk3_update_refresh_mode(ctx, ctx->current_mode, 0);
+	dev_dbg(ctx->dev, "%s: pixel off instead of dbv 0\n", __func__);
+}
+
+static void hk3_fast_blank_exit(struct exynos_panel *ctx)
+{
+	struct hk3_panel *spanel = to_spanel(ctx);
+
+	EXYNOS_DCS_WRITE_SEQ(ctx, MIPI_DCS_ENTER_NORMAL_MODE);
+	spanel->is_pixel_off = false;
+	hk3_change_frequency(ctx, ctx->current_mode);
+}
+
 static int hk3_set_brightness(struct exynos_panel *ctx, u16 br)
 {
 	int ret;
@@ -1323,70 +2064,43 @@ static int hk3_set_brightness(struct exynos_panel *ctx, u16 br)
 
 	/* Use pixel off command instead of setting DBV 0 */
 	if (!br) {
-		if (!spanel->is_pixel_off) {
-			EXYNOS_DCS_WRITE_TABLE(ctx, pixel_off);
-			spanel->is_pixel_off = true;
-			dev_dbg(ctx->dev, "%s: pixel off instead of dbv 0\n", __func__);
-		}
+		if (!spanel->is_pixel_off)
+			hk3_fast_blank_enter(ctx);
 		return 0;
 	} else if (br && spanel->is_pixel_off) {
-		EXYNOS_DCS_WRITE_SEQ(ctx, MIPI_DCS_ENTER_NORMAL_MODE);
-		spanel->is_pixel_off = false;
+		hk3_fast_blank_exit(ctx);
+	}
+
+	spanel->req_dbv = br;
+	if (br > hk3_get_max_dbv(spanel)) {
+		dev_dbg(ctx->dev, "%s: cap dbv %u to %u\n", __func__, br, hk3_get_max_dbv(spanel));
+		br = hk3_get_max_dbv(spanel);
 	}
 
 	brightness = (br & 0xff) << 8 | br >> 8;
 	ret = exynos_dcs_set_brightness(ctx, brightness);
 	if (!ret) {
 		spanel->hw_dbv = br;
+		hk3_publish_hw_state(spanel);
 		hk3_set_acl_mode(ctx, ctx->acl_mode);
+		hk3_update_idle_floor(ctx);
 	}
 
 	return ret;
 }
 
-static const struct exynos_dsi_cmd hk3_display_on_cmds[] = {
-	EXYNOS_DSI_CMD0(unlock_cmd_f0),
-	EXYNOS_DSI_CMD0(sync_begin),
-	/* AMP type change (return) */
-	EXYNOS_DSI_CMD_SEQ(0xB0, 0x00, 0x4F, 0xF4),
-	EXYNOS_DSI_CMD_SEQ(0xF4, 0x70),
-	/* Vreg = 7.1V (return) */
-	EXYNOS_DSI_CMD_SEQ(0xB0, 0x00, 0x31, 0xF4),
-	EXYNOS_DSI_CMD_SEQ_REV(PANEL_REV_GE(PANEL_REV_DVT1), 0xF4, 0x1A, 0x1A, 0x1A, 0x1A, 0x1A),
-	EXYNOS_DSI_CMD_SEQ_REV(PANEL_REV_LT(PANEL_REV_DVT1), 0xF4, 0x1B, 0x1B, 0x1B, 0x1B, 0x1B),
-	EXYNOS_DSI_CMD0(sync_end),
-	EXYNOS_DSI_CMD0(lock_cmd_f0),
-
-	EXYNOS_DSI_CMD_SEQ(MIPI_DCS_SET_DISPLAY_ON),
-};
-static DEFINE_EXYNOS_CMD_SET(hk3_display_on);
-
-static const struct exynos_dsi_cmd hk3_display_off_cmds[] = {
-	EXYNOS_DSI_CMD_SEQ(MIPI_DCS_SET_DISPLAY_OFF),
-
-	EXYNOS_DSI_CMD0(unlock_cmd_f0),
-	EXYNOS_DSI_CMD0(sync_begin),
-	/* AMP type change */
-	EXYNOS_DSI_CMD_SEQ(0xB0, 0x00, 0x4F, 0xF4),
-	EXYNOS_DSI_CMD_SEQ(0xF4, 0x50),
-	/* Vreg = 4.5 */
-	EXYNOS_DSI_CMD_SEQ(0xB0, 0x00, 0x31, 0xF4),
-	EXYNOS_DSI_CMD_SEQ(0xF4, 0x00, 0x00, 0x00, 0x00, 0x00),
-	EXYNOS_DSI_CMD0(sync_end),
-	EXYNOS_DSI_CMD0(lock_cmd_f0),
-};
-static DEFINE_EXYNOS_CMD_SET(hk3_display_off);
-
 static unsigned int hk3_get_te_usec(struct exynos_panel *ctx,
 				    const struct exynos_panel_mode *pmode)
 {
 	struct hk3_panel *spanel = to_spanel(ctx);
+	struct hk3_hw_state state;
 
-	if (spanel->hw_vrefresh != 60)
+	hk3_get_hw_state(spanel, &state);
+	if (state.vrefresh != 60)
 		return pmode->exynos_mode.te_usec;
 	else
-		return (test_bit(FEAT_OP_NS, spanel->feat) ? HK3_TE_USEC_60HZ_NS :
-							     HK3_TE_USEC_60HZ_HS);
+		return (test_bit(FEAT_OP_NS, state.feat) ? HK3_TE_USEC_60HZ_NS :
+							   HK3_TE_USEC_60HZ_HS);
 }
 
 static u32 hk3_get_te_width_usec(u32 vrefresh, bool is_ns)
@@ -1457,11 +2171,15 @@ static void hk3_set_lp_mode(struct exynos_panel *ctx, const struct exynos_panel_
 	bool is_ns = test_bit(FEAT_OP_NS, spanel->feat);
 	bool panel_enabled = is_panel_enabled(ctx);
 	u32 vrefresh = panel_enabled ? spanel->hw_vrefresh : 60;
+	ktime_t start;
 
 	dev_dbg(ctx->dev, "%s: panel: %s\n", __func__, panel_enabled ? "ON" : "OFF");
 
 	DPU_ATRACE_BEGIN(__func__);
+	start = hk3_trans_begin(TRANS_LP);
 
+	/* early exit is on at hinted rates, the next frame comes at @hw_vrefresh */
+	spanel->hint_vrefresh = 0;
 	hk3_disable_panel_feat(ctx, vrefresh);
 	if (panel_enabled) {
 		/* init sequence has sent display-off command already */
@@ -1469,7 +2187,7 @@ static void hk3_set_lp_mode(struct exynos_panel *ctx, const struct exynos_panel_
 			hk3_wait_for_vsync_done_changeable(ctx, vrefresh, is_ns);
 		else
 			hk3_wait_for_vsync_done(ctx, vrefresh, is_ns);
-		exynos_panel_send_cmd_set(ctx, &hk3_display_off_cmd_set);
+		hk3_send_cmd_set(ctx, &hk3_display_off_cmd_set, CMD_SET_DISPLAY_OFF);
 	}
 	/* display should be off here, set dbv before entering lp mode */
 	EXYNOS_DCS_BUF_ADD_SET_AND_FLUSH(ctx, aod_dbv);
@@ -1503,16 +2221,27 @@ static void hk3_set_lp_mode(struct exynos_panel *ctx, const struct exynos_panel_
 	EXYNOS_DCS_BUF_ADD(ctx, 0xBD, 0x22, 0x22, 0x22, 0x22);
 	EXYNOS_DCS_BUF_ADD_SET(ctx, freq_update);
 	EXYNOS_DCS_BUF_ADD_SET_AND_FLUSH(ctx, lock_cmd_f0);
-	exynos_panel_send_cmd_set(ctx, &hk3_display_on_cmd_set);
+	hk3_send_cmd_set(ctx, &hk3_display_on_cmd_set, CMD_SET_DISPLAY_ON);
 
 	spanel->hw_vrefresh = 30;
+	hk3_publish_hw_state(spanel);
 	spanel->read_vreg = true;
+	/* TE2 is reprogrammed after exiting AOD */
+	spanel->hw_te2_option = 0;
 
+	hk3_trans_end(ctx, TRANS_LP, start);
 	DPU_ATRACE_END(__func__);
 
 	dev_info(ctx->dev, "enter %dhz LP mode\n", drm_mode_vrefresh(&pmode->mode));
 }
 
+static void hk3_mark_nolp(struct exynos_panel *ctx, enum hk3_nolp_step step)
+{
+	struct hk3_panel *spanel = to_spanel(ctx);
+
+	spanel->nolp_us[step] = ktime_us_delta(ktime_get(), spanel->nolp_start);
+}
+
 static void hk3_set_nolp_mode(struct exynos_panel *ctx,
 			      const struct exynos_panel_mode *pmode)
 {
@@ -1521,6 +2250,7 @@ static void hk3_set_nolp_mode(struct exynos_panel *ctx,
 	dev_dbg(ctx->dev, "%s\n", __func__);
 
 	DPU_ATRACE_BEGIN(__func__);
+	spanel->nolp_start = hk3_trans_begin(TRANS_NOLP);
 
 	EXYNOS_DCS_BUF_ADD_SET(ctx, unlock_cmd_f0);
 	/* manual mode */
@@ -1539,10 +2269,20 @@ static void hk3_set_nolp_mode(struct exynos_panel *ctx,
 	spanel->hw_idle_vrefresh = 0;
 
 	hk3_wait_for_vsync_done(ctx, 30, false);
-	exynos_panel_send_cmd_set(ctx, &hk3_display_off_cmd_set);
+	hk3_mark_nolp(ctx, NOLP_TE_SYNC);
+	hk3_send_cmd_set(ctx, &hk3_display_off_cmd_set, CMD_SET_DISPLAY_OFF);
 
 	hk3_wait_for_vsync_done(ctx, 30, false);
-	EXYNOS_DCS_BUF_ADD_SET(ctx, unlock_cmd_f0);
+	hk3_mark_nolp(ctx, NOLP_DISPLAY_OFF);
+
+	/*
+	 * Everything up to display on only needs display off to be effective, so queue
+	 * it as a single burst rather than flushing AOD off, the enforced feature update,
+	 * WRCTRLD and the frequency change one by one.
+	 */
+	DPU_ATRACE_BEGIN("hk3_nolp_burst");
+	hk3_maint_begin(ctx);
+	hk3_maint_unlock(ctx);
 	/* TE width setting */
 	EXYNOS_DCS_BUF_ADD(ctx, 0xB0, 0x00, 0x04, 0xB9);
 	EXYNOS_DCS_BUF_ADD(ctx, 0xB9, 0x0B, 0xBB, 0x00, 0x2F, /* changeable TE */
@@ -1550,18 +2290,23 @@ static void hk3_set_nolp_mode(struct exynos_panel *ctx,
 	/* disabling AOD low Mode is a must before aod-off */
 	EXYNOS_DCS_BUF_ADD(ctx, 0xB0, 0x00, 0x52, 0x94);
 	EXYNOS_DCS_BUF_ADD(ctx, 0x94, 0x00);
-	EXYNOS_DCS_BUF_ADD_SET(ctx, lock_cmd_f0);
-	EXYNOS_DCS_BUF_ADD_SET_AND_FLUSH(ctx, aod_off);
+	EXYNOS_DCS_BUF_ADD_SET(ctx, aod_off);
 	hk3_update_panel_feat(ctx, drm_mode_vrefresh(&pmode->mode), true);
 	/* backlight control and dimming */
-	hk3_write_display_mode(ctx, &pmode->mode);
+	EXYNOS_DCS_BUF_ADD(ctx, MIPI_DCS_WRITE_CONTROL_DISPLAY, hk3_get_wrctrld(ctx));
 	hk3_change_frequency(ctx, pmode);
-	exynos_panel_send_cmd_set(ctx, &hk3_display_on_cmd_set);
+	hk3_maint_end(ctx);
+	DPU_ATRACE_END("hk3_nolp_burst");
+	hk3_mark_nolp(ctx, NOLP_AOD_OFF);
+
+	hk3_send_cmd_set(ctx, &hk3_display_on_cmd_set, CMD_SET_DISPLAY_ON);
+	hk3_mark_nolp(ctx, NOLP_DISPLAY_ON);
 	spanel->read_vreg = true;
 
+	hk3_trans_end(ctx, TRANS_NOLP, spanel->nolp_start);
 	DPU_ATRACE_END(__func__);
 
-	dev_info(ctx->dev, "exit LP mode\n");
+	dev_info(ctx->dev, "exit LP mode (%lld us)\n", spanel->nolp_us[NOLP_DISPLAY_ON]);
 }
 
 static const struct exynos_dsi_cmd hk3_init_cmds[] = {
@@ -1676,6 +2421,14 @@ static void hk3_negative_field_setting(struct exynos_panel *ctx)
 	EXYNOS_DCS_BUF_ADD_SET_AND_FLUSH(ctx, lock_cmd_f0);
 }
 
+static int hk3_prepare(struct drm_panel *panel)
+{
+	struct exynos_panel *ctx = container_of(panel, struct exynos_panel, panel);
+	struct hk3_panel *spanel = to_spanel(ctx);
+
+	return panel_google_pwr_on_prepare(panel, &spanel->pwr_on);
+}
+
 static int hk3_enable(struct drm_panel *panel)
 {
 	struct exynos_panel *ctx = container_of(panel, struct exynos_panel, panel);
@@ -1700,8 +2453,12 @@ static int hk3_enable(struct drm_panel *panel)
 
 	DPU_ATRACE_BEGIN(__func__);
 
-	if (needs_reset)
+	if (needs_reset) {
 		exynos_panel_reset(ctx);
+		panel_google_mark_pwr_on(&spanel->pwr_on, PANEL_GOOGLE_PWR_ON_RESET);
+		/* TE2 registers are back to their defaults */
+		spanel->hw_te2_option = 0;
+	}
 
 	if (ctx->mode_in_progress == MODE_RES_IN_PROGRESS) {
 		u32 te_width_us = hk3_get_te_width_usec(vrefresh, is_ns);
@@ -1722,7 +2479,7 @@ static int hk3_enable(struct drm_panel *panel)
 	EXYNOS_PPS_WRITE_BUF(ctx, &pps_payload);
 
 	if (needs_reset) {
-		exynos_panel_send_cmd_set(ctx, &hk3_init_cmd_set);
+		hk3_send_cmd_set(ctx, &hk3_init_cmd_set, CMD_SET_INIT);
 		if (ctx->panel_rev == PANEL_REV_PROTO1)
 			hk3_lhbm_luminance_opr_setting(ctx);
 		if (ctx->panel_rev >= PANEL_REV_DVT1)
@@ -1730,6 +2487,7 @@ static int hk3_enable(struct drm_panel *panel)
 
 		spanel->is_pixel_off = false;
 		ctx->dsi_hs_clk = MIPI_DSI_FREQ_DEFAULT;
+		panel_google_mark_pwr_on(&spanel->pwr_on, PANEL_GOOGLE_PWR_ON_INIT);
 	}
 	PANEL_SEQ_LABEL_END("init");
 
@@ -1741,7 +2499,7 @@ static int hk3_enable(struct drm_panel *panel)
 	EXYNOS_DCS_BUF_ADD_SET_AND_FLUSH(ctx, lock_cmd_f0);
 
 	if (needs_reset && spanel->material == MATERIAL_E7_DOE)
-		exynos_panel_send_cmd_set(ctx, &hk3_ns_gamma_fix_cmd_set);
+		hk3_send_cmd_set(ctx, &hk3_ns_gamma_fix_cmd_set, CMD_SET_NS_GAMMA_FIX);
 
 	if (pmode->exynos_mode.is_lp_mode) {
 		hk3_set_lp_mode(ctx, pmode);
@@ -1752,13 +2510,17 @@ static int hk3_enable(struct drm_panel *panel)
 
 		if (needs_reset || (ctx->panel_state == PANEL_STATE_BLANK)) {
 			hk3_wait_for_vsync_done(ctx, needs_reset ? 60 : vrefresh, is_ns);
-			exynos_panel_send_cmd_set(ctx, &hk3_display_on_cmd_set);
+			hk3_send_cmd_set(ctx, &hk3_display_on_cmd_set, CMD_SET_DISPLAY_ON);
 			spanel->read_vreg = true;
 		}
 	}
 
 	spanel->lhbm_ctl.hist_roi_configured = false;
 
+	if (needs_reset) {
+		panel_google_pwr_on_done(&spanel->pwr_on, ctx->dev);
+	}
+
 	DPU_ATRACE_END(__func__);
 
 	return 0;
@@ -1793,7 +2555,7 @@ static int hk3_disable(struct drm_panel *panel)
 	 */
 	exynos_panel_msleep(EXYNOS_VREFRESH_TO_PERIOD_USEC(vrefresh) / 1000 + 1);
 
-	exynos_panel_send_cmd_set(ctx, &hk3_display_off_cmd_set);
+	hk3_send_cmd_set(ctx, &hk3_display_off_cmd_set, CMD_SET_DISPLAY_OFF);
 	exynos_panel_msleep(20);
 	if (ctx->panel_state == PANEL_STATE_OFF)
 		EXYNOS_DCS_WRITE_SEQ_DELAY(ctx, 100, MIPI_DCS_ENTER_SLEEP_MODE);
@@ -1801,10 +2563,15 @@ static int hk3_disable(struct drm_panel *panel)
 	/* panel register state gets reset after disabling hardware */
 	bitmap_clear(spanel->hw_feat, 0, FEAT_MAX);
 	spanel->hw_vrefresh = 60;
+	spanel->hw_hint_vrefresh = 0;
 	spanel->hw_idle_vrefresh = 0;
+	spanel->hint_vrefresh = 0;
+	spanel->hw_te2_option = 0;
 	spanel->hw_acl_setting = 0;
 	spanel->hw_za_enabled = false;
 	spanel->hw_dbv = 0;
+	spanel->idle_floor_vrefresh = hk3_get_idle_floor(0);
+	hk3_publish_hw_state(spanel);
 
 	return 0;
 }
@@ -1828,6 +2595,7 @@ static int hk3_disable(struct drm_panel *panel)
 static void hk3_update_idle_state(struct exynos_panel *ctx)
 {
 	s64 delta_us;
+	ktime_t start;
 	struct hk3_panel *spanel = to_spanel(ctx);
 
 	ctx->panel_idle_vrefresh = 0;
@@ -1845,6 +2613,7 @@ static void hk3_update_idle_state(struct exynos_panel *ctx)
 	ctx->last_mode_set_ts = ktime_get();
 
 	DPU_ATRACE_BEGIN(__func__);
+	start = hk3_trans_begin(TRANS_EARLY_EXIT);
 
 	if (!ctx->idle_delay_ms && spanel->force_changeable_te) {
 		dev_dbg(ctx->dev, "sending early exit out cmd\n");
@@ -1856,6 +2625,7 @@ static void hk3_update_idle_state(struct exynos_panel *ctx)
 		hk3_update_refresh_mode(ctx, ctx->current_mode, 0);
 	}
 
+	hk3_trans_end(ctx, TRANS_EARLY_EXIT, start);
 	DPU_ATRACE_END(__func__);
 }
 
@@ -1863,6 +2633,13 @@ static void hk3_commit_done(struct exynos_panel *ctx)
 {
 	struct hk3_panel *spanel = to_spanel(ctx);
 
+	if (spanel->idle_exit_ts) {
+		spanel->idle_exit_latency_us = ktime_us_delta(ktime_get(), spanel->idle_exit_ts);
+		spanel->idle_exit_latency_max_us = max(spanel->idle_exit_latency_max_us,
+						       spanel->idle_exit_latency_us);
+		spanel->idle_exit_ts = 0;
+	}
+
 	if (ctx->current_mode->exynos_mode.is_lp_mode)
 		return;
 
@@ -1881,44 +2658,76 @@ static void hk3_commit_done(struct exynos_panel *ctx)
 		hk3_update_disp_therm(ctx);
 }
 
-static void hk3_set_hbm_mode(struct exynos_panel *ctx,
-			     enum exynos_hbm_mode mode)
+/*
+ * Update the HBM and IRC feature bits from the requested HBM mode and the BCL state. Returns
+ * true if any of them changed.
+ */
+static bool hk3_update_hbm_feat(struct exynos_panel *ctx)
 {
 	struct hk3_panel *spanel = to_spanel(ctx);
-	const struct exynos_panel_mode *pmode = ctx->current_mode;
-
-	if (mode == ctx->hbm_mode)
-		return;
-
-	if (unlikely(!pmode))
-		return;
+	const int irc_bit = ctx->panel_rev >= PANEL_REV_EVT1 ? FEAT_IRC_Z_MODE : FEAT_IRC_OFF;
+	DECLARE_BITMAP(old_feat, FEAT_MAX);
 
-	ctx->hbm_mode = mode;
+	bitmap_copy(old_feat, spanel->feat, FEAT_MAX);
 
-	if (IS_HBM_ON(mode)) {
+	if (hk3_is_hbm_on(ctx)) {
 		set_bit(FEAT_HBM, spanel->feat);
 		/* enforce IRC on for factory builds */
 #ifndef PANEL_FACTORY_BUILD
-		if (mode == HBM_ON_IRC_ON)
-			clear_bit(ctx->panel_rev >= PANEL_REV_EVT1 ?
-				  FEAT_IRC_Z_MODE : FEAT_IRC_OFF, spanel->feat);
+		if (ctx->hbm_mode == HBM_ON_IRC_ON)
+			clear_bit(irc_bit, spanel->feat);
 		else
-			set_bit(ctx->panel_rev >= PANEL_REV_EVT1 ?
-				FEAT_IRC_Z_MODE : FEAT_IRC_OFF, spanel->feat);
+			set_bit(irc_bit, spanel->feat);
 #endif
 	} else {
 		clear_bit(FEAT_HBM, spanel->feat);
-		clear_bit(ctx->panel_rev >= PANEL_REV_EVT1 ?
-			  FEAT_IRC_Z_MODE : FEAT_IRC_OFF, spanel->feat);
+		clear_bit(irc_bit, spanel->feat);
 	}
 
-	if (ctx->panel_state == PANEL_STATE_NORMAL) {
-		if (!IS_HBM_ON(mode))
-			hk3_write_display_mode(ctx, &pmode->mode);
-		hk3_update_panel_feat(ctx, drm_mode_vrefresh(&pmode->mode), false);
-		if (IS_HBM_ON(mode))
-			hk3_write_display_mode(ctx, &pmode->mode);
-	}
+	return !bitmap_equal(old_feat, spanel->feat, FEAT_MAX);
+}
+
+static void hk3_write_hbm_feat(struct exynos_panel *ctx)
+{
+	const struct exynos_panel_mode *pmode = ctx->current_mode;
+	const ktime_t start = hk3_trans_begin(TRANS_HBM);
+	const u8 wrctrld = hk3_get_wrctrld(ctx);
+	const bool hbm_on = hk3_is_hbm_on(ctx);
+
+	/*
+	 * Queue WRCTRLD, the EM cycle/frequency block and the IRC setting behind one
+	 * unlock so they latch on the same frame. WRCTRLD leaves HBM before the
+	 * feature update and enters it after, as with separate flushes.
+	 */
+	DPU_ATRACE_BEGIN("hk3_hbm_burst");
+	hk3_maint_begin(ctx);
+	hk3_maint_unlock(ctx);
+	if (!hbm_on)
+		EXYNOS_DCS_BUF_ADD(ctx, MIPI_DCS_WRITE_CONTROL_DISPLAY, wrctrld);
+	hk3_update_panel_feat(ctx, drm_mode_vrefresh(&pmode->mode), false);
+	if (hbm_on)
+		EXYNOS_DCS_BUF_ADD(ctx, MIPI_DCS_WRITE_CONTROL_DISPLAY, wrctrld);
+	hk3_maint_end(ctx);
+	DPU_ATRACE_END("hk3_hbm_burst");
+	hk3_trans_end(ctx, TRANS_HBM, start);
+}
+
+static void hk3_set_hbm_mode(struct exynos_panel *ctx,
+			     enum exynos_hbm_mode mode)
+{
+	const struct exynos_panel_mode *pmode = ctx->current_mode;
+
+	if (mode == ctx->hbm_mode)
+		return;
+
+	if (unlikely(!pmode))
+		return;
+
+	ctx->hbm_mode = mode;
+
+	/* nothing changes on the panel while BCL holds HBM off */
+	if (hk3_update_hbm_feat(ctx) && ctx->panel_state == PANEL_STATE_NORMAL)
+		hk3_write_hbm_feat(ctx);
 }
 
 static void hk3_set_dimming_on(struct exynos_panel *ctx,
@@ -1950,31 +2759,10 @@ static void hk3_set_local_hbm_brightness(struct exynos_panel *ctx, bool is_first
 	if (is_first_stage) {
 		u32 gray = exynos_drm_connector_get_lhbm_gray_level(&ctx->exynos_connector);
 		u32 dbv = exynos_panel_get_brightness(ctx);
-		u32 normal_dbv_max = ctx->desc->brt_capability->normal.level.max;
-		u32 normal_nit_max = ctx->desc->brt_capability->normal.nits.max;
-		u32 luma = 0;
 
-		if (gray < 15) {
-			group = LHBM_OVERDRIVE_GRP_0_NIT;
-		} else {
-			if (dbv <= normal_dbv_max)
-				luma = panel_cmn_calc_gamma_2_2_luminance(dbv, normal_dbv_max,
-				normal_nit_max);
-			else
-				luma = panel_cmn_calc_linear_luminance(dbv, 700, -1271);
-			luma = panel_cmn_calc_gamma_2_2_luminance(gray, 255, luma);
-
-			if (luma < 6)
-				group = LHBM_OVERDRIVE_GRP_6_NIT;
-			else if (luma < 50)
-				group = LHBM_OVERDRIVE_GRP_50_NIT;
-			else if (luma < 300)
-				group = LHBM_OVERDRIVE_GRP_300_NIT;
-			else
-				group = LHBM_OVERDRIVE_GRP_MAX;
-		}
-		dev_dbg(ctx->dev, "check LHBM overdrive condition | gray=%u dbv=%u luma=%u\n",
-			gray, dbv, luma);
+		group = panel_google_get_lhbm_od_group(&spanel->brt_lut, dbv, gray);
+		dev_dbg(ctx->dev, "check LHBM overdrive condition | gray=%u dbv=%u nits=%u\n",
+			gray, dbv, panel_google_get_brt_lut(&spanel->brt_lut, dbv)->nits);
 	}
 
 	if (group < LHBM_OVERDRIVE_GRP_MAX) {
@@ -2020,7 +2808,12 @@ static void hk3_set_local_hbm_mode_post(struct exynos_panel *ctx)
 static void hk3_mode_set(struct exynos_panel *ctx,
 			 const struct exynos_panel_mode *pmode)
 {
+	const enum hk3_trans_type type = (ctx->mode_in_progress == MODE_RES_IN_PROGRESS ||
+		ctx->mode_in_progress == MODE_RES_AND_RR_IN_PROGRESS) ? TRANS_RRS : TRANS_RR;
+	const ktime_t start = hk3_trans_begin(type);
+
 	hk3_change_frequency(ctx, pmode);
+	hk3_trans_end(ctx, type, start);
 }
 
 static bool hk3_is_mode_seamless(const struct exynos_panel *ctx,
@@ -2053,8 +2846,12 @@ static int hk3_set_op_hz(struct exynos_panel *ctx, unsigned int hz)
 	else
 		clear_bit(FEAT_OP_NS, spanel->feat);
 
-	if (is_panel_active(ctx))
+	if (is_panel_active(ctx)) {
+		const ktime_t start = hk3_trans_begin(TRANS_OP_HZ);
+
 		hk3_update_panel_feat(ctx, vrefresh, false);
+		hk3_trans_end(ctx, TRANS_OP_HZ, start);
+	}
 	dev_info(ctx->dev, "%s op_hz at %d\n",
 		is_panel_active(ctx) ? "set" : "cache", hz);
 
@@ -2095,6 +2892,30 @@ static void hk3_get_panel_material(struct exynos_panel *ctx, u32 id)
 	dev_info(ctx->dev, "%s: %d\n", __func__, spanel->material);
 }
 
+static const struct exynos_dsi_cmd_set *hk3_cmd_sets[CMD_SET_MAX] = {
+	[CMD_SET_INIT] = &hk3_init_cmd_set,
+	[CMD_SET_NS_GAMMA_FIX] = &hk3_ns_gamma_fix_cmd_set,
+	[CMD_SET_DISPLAY_ON] = &hk3_display_on_cmd_set,
+	[CMD_SET_DISPLAY_OFF] = &hk3_display_off_cmd_set,
+};
+
+static const char * const hk3_cmd_set_names[CMD_SET_MAX] = {
+	[CMD_SET_INIT] = "init",
+	[CMD_SET_NS_GAMMA_FIX] = "ns_gamma_fix",
+	[CMD_SET_DISPLAY_ON] = "display_on",
+	[CMD_SET_DISPLAY_OFF] = "display_off",
+};
+
+/* filter and pack the command sets once the panel revision is known */
+static void hk3_resolve_cmd_sets(struct exynos_panel *ctx)
+{
+	struct hk3_panel *spanel = to_spanel(ctx);
+	int i;
+
+	for (i = 0; i < CMD_SET_MAX; i++)
+		panel_google_resolve_cmd_set(ctx, hk3_cmd_sets[i], &spanel->cmd_sets[i]);
+}
+
 static void hk3_get_panel_rev(struct exynos_panel *ctx, u32 id)
 {
 	/* extract command 0xDB */
@@ -2104,6 +2925,70 @@ static void hk3_get_panel_rev(struct exynos_panel *ctx, u32 id)
 	exynos_panel_get_panel_rev(ctx, rev);
 
 	hk3_get_panel_material(ctx, id);
+	hk3_resolve_cmd_sets(ctx);
+}
+
+/*
+ * Re-apply the requested brightness after the dbv cap, ACL floor or BCL state changed. The
+ * dbv drops below the HBM range before HBM is turned off.
+ */
+static void hk3_apply_dbv_cap(struct exynos_panel *ctx)
+{
+	struct hk3_panel *spanel = to_spanel(ctx);
+	/* a panel that's off or in AOD picks the feature bits up on the next enable */
+	const bool hbm_changed = hk3_update_hbm_feat(ctx);
+
+	if (ctx->panel_state != PANEL_STATE_NORMAL ||
+	    !ctx->current_mode || ctx->current_mode->exynos_mode.is_lp_mode)
+		return;
+
+	DPU_ATRACE_BEGIN(__func__);
+	if (!spanel->is_pixel_off) {
+		if (min(spanel->req_dbv, hk3_get_max_dbv(spanel)) != spanel->hw_dbv)
+			hk3_set_brightness(ctx, spanel->req_dbv);
+		else
+			/* dbv is unchanged, but the ACL floor may be */
+			hk3_set_acl_mode(ctx, ctx->acl_mode);
+	}
+	if (hbm_changed)
+		hk3_write_hbm_feat(ctx);
+	DPU_ATRACE_END(__func__);
+}
+
+/*
+ * Evaluate the HBM derating level from disp_therm. When the temperature crosses into a higher
+ * level the dbv cap drops to that level right away. Once it cools down, the cap is raised one
+ * step per evaluation so the brightness change isn't noticeable. The brightness is re-applied
+ * if the effective dbv changes.
+ */
+static void hk3_update_therm_derating(struct exynos_panel *ctx, int temp)
+{
+	struct hk3_panel *spanel = to_spanel(ctx);
+	const struct hk3_therm_derate *table = hk3_therm_derate_table;
+	u8 level = spanel->derate_level;
+	u16 target, max_dbv;
+
+	while (level + 1 < ARRAY_SIZE(hk3_therm_derate_table) && temp >= table[level + 1].temp)
+		level++;
+	while (level > 0 && temp < table[level].temp - HK3_DERATE_HYST_DEG)
+		level--;
+
+	target = table[level].max_dbv;
+	max_dbv = spanel->derate_max_dbv;
+	if (max_dbv > target)
+		max_dbv = target;
+	else if (max_dbv < target)
+		max_dbv = min_t(int, target, max_dbv + HK3_DERATE_DBV_STEP);
+
+	if (level == spanel->derate_level && max_dbv == spanel->derate_max_dbv)
+		return;
+
+	dev_info(ctx->dev, "%s: temp=%d level %u->%u max_dbv %u->%u\n", __func__, temp,
+		 spanel->derate_level, level, spanel->derate_max_dbv, max_dbv);
+	spanel->derate_level = level;
+	spanel->derate_max_dbv = max_dbv;
+
+	hk3_apply_dbv_cap(ctx);
 }
 
 static void hk3_normal_mode_work(struct exynos_panel *ctx)
@@ -2112,8 +2997,12 @@ static void hk3_normal_mode_work(struct exynos_panel *ctx)
 		hk3_update_disp_therm(ctx);
 	} else {
 		struct hk3_panel *spanel = to_spanel(ctx);
+		int temp;
 
 		spanel->pending_temp_update = true;
+		/* derating can't wait for the next idle or commit */
+		if (!hk3_read_disp_therm(ctx, &temp))
+			hk3_update_therm_derating(ctx, temp);
 	}
 }
 
@@ -2174,9 +3063,10 @@ static void hk3_update_ffc(struct exynos_panel *ctx, unsigned int hs_clk)
 
 static void hk3_get_pwr_vreg(struct exynos_panel *ctx, char *buf, size_t len)
 {
-	struct hk3_panel *spanel = to_spanel(ctx);
+	struct hk3_hw_state state;
 
-	strlcpy(buf, spanel->hw_vreg, len);
+	hk3_get_hw_state(to_spanel(ctx), &state);
+	strlcpy(buf, state.vreg, len);
 }
 
 static const struct exynos_display_underrun_param underrun_param = {
@@ -2600,6 +3490,84 @@ static void hk3_lhbm_brightness_init(struct exynos_panel *ctx)
 	}
 }
 
+#ifdef CONFIG_DEBUG_FS
+static int hk3_nolp_timeline_show(struct seq_file *m, void *data)
+{
+	struct hk3_panel *spanel = to_spanel((struct exynos_panel *)m->private);
+	static const char * const names[NOLP_STEP_MAX] = {
+		[NOLP_TE_SYNC] = "te_sync",
+		[NOLP_DISPLAY_OFF] = "display_off",
+		[NOLP_AOD_OFF] = "aod_off",
+		[NOLP_DISPLAY_ON] = "display_on",
+	};
+	int i;
+
+	for (i = 0; i < NOLP_STEP_MAX; i++)
+		seq_printf(m, "%s: %lld us\n", names[i], spanel->nolp_us[i]);
+
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(hk3_nolp_timeline);
+
+static int hk3_hw_state_show(struct seq_file *m, void *data)
+{
+	struct hk3_panel *spanel = to_spanel((struct exynos_panel *)m->private);
+	struct hk3_hw_state state;
+
+	hk3_get_hw_state(spanel, &state);
+	seq_printf(m, "feat: %*pb\n", FEAT_MAX, state.feat);
+	seq_printf(m, "vrefresh: %u\n", state.vrefresh);
+	seq_printf(m, "hint_vrefresh: %u\n", state.hint_vrefresh);
+	seq_printf(m, "idle_vrefresh: %u\n", state.idle_vrefresh);
+	seq_printf(m, "temp: %u\n", state.temp);
+	seq_printf(m, "dbv: %u\n", state.dbv);
+	seq_printf(m, "acl_setting: %u\n", state.acl_setting);
+	seq_printf(m, "za_enabled: %d\n", state.za_enabled);
+	seq_printf(m, "vreg: %s\n", state.vreg);
+
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(hk3_hw_state);
+
+static int hk3_transitions_show(struct seq_file *m, void *data)
+{
+	struct hk3_panel *spanel = to_spanel((struct exynos_panel *)m->private);
+	struct hk3_trans_log *log;
+	u32 i, n, first;
+
+	log = kmalloc(sizeof(*log), GFP_KERNEL);
+	if (!log)
+		return -ENOMEM;
+
+	spin_lock_irq(&spanel->trans_log.lock);
+	memcpy(log, &spanel->trans_log, sizeof(*log));
+	spin_unlock_irq(&spanel->trans_log.lock);
+
+	seq_puts(m, "type: <1ms <2ms <4ms <8ms <16ms <32ms >=32ms\n");
+	for (i = 0; i < TRANS_MAX; i++) {
+		seq_printf(m, "%s:", hk3_trans_names[i] + strlen("hk3_trans_"));
+		for (n = 0; n < HK3_TRANS_HIST_SIZE; n++)
+			seq_printf(m, " %u", log->hist[i][n]);
+		seq_putc(m, '\n');
+	}
+
+	seq_puts(m, "\nstart_ns type dur_us vrefresh te\n");
+	n = min_t(u32, log->count, HK3_TRANS_LOG_SIZE);
+	first = log->count - n;
+	for (i = first; i < log->count; i++) {
+		const struct hk3_trans_rec *rec = &log->rec[i % HK3_TRANS_LOG_SIZE];
+
+		seq_printf(m, "%lld %s %u %u %s\n", ktime_to_ns(rec->start),
+			   hk3_trans_names[rec->type] + strlen("hk3_trans_"), rec->dur_us,
+			   rec->vrefresh, rec->fixed_te ? "fixed" : "changeable");
+	}
+	kfree(log);
+
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(hk3_transitions);
+#endif
+
 static void hk3_panel_init(struct exynos_panel *ctx)
 {
 #ifdef CONFIG_DEBUG_FS
@@ -2615,6 +3583,25 @@ static void hk3_panel_init(struct exynos_panel *ctx)
 				&spanel->force_za_off);
 	debugfs_create_u8("hw_acl_setting", 0644, ctx->debugfs_entry,
 				&spanel->hw_acl_setting);
+	debugfs_create_u8("derate_level", 0444, ctx->debugfs_entry,
+				&spanel->derate_level);
+	debugfs_create_u16("derate_max_dbv", 0444, ctx->debugfs_entry,
+				&spanel->derate_max_dbv);
+	debugfs_create_u16("bcl_max_dbv", 0444, ctx->debugfs_entry,
+				&spanel->bcl.max_dbv);
+	panel_google_pwr_on_debugfs_init(&spanel->pwr_on, ctx->debugfs_entry);
+	debugfs_create_file("nolp_timeline", 0444, ctx->debugfs_entry, ctx,
+				&hk3_nolp_timeline_fops);
+	panel_google_brt_lut_debugfs_init(&spanel->brt_lut, ctx->debugfs_entry);
+	debugfs_create_file("hw_state", 0444, ctx->debugfs_entry, ctx, &hk3_hw_state_fops);
+	debugfs_create_file("transitions", 0444, ctx->debugfs_entry, ctx,
+				&hk3_transitions_fops);
+	panel_google_cmd_set_debugfs_init(ctx->dev, ctx->debugfs_entry, spanel->cmd_sets,
+					  hk3_cmd_set_names, CMD_SET_MAX);
+	debugfs_create_u32("idle_exit_latency_us", 0444, ctx->debugfs_entry,
+				&spanel->idle_exit_latency_us);
+	debugfs_create_u32("idle_exit_latency_max_us", 0644, ctx->debugfs_entry,
+				&spanel->idle_exit_latency_max_us);
 #endif
 
 #ifdef PANEL_FACTORY_BUILD
@@ -2639,26 +3626,127 @@ static void hk3_panel_init(struct exynos_panel *ctx)
 			__func__);
 }
 
+static ssize_t frame_rate_hint_show(struct device *dev, struct device_attribute *attr,
+				    char *buf)
+{
+	struct mipi_dsi_device *dsi = to_mipi_dsi_device(dev);
+	struct exynos_panel *ctx = mipi_dsi_get_drvdata(dsi);
+	struct hk3_panel *spanel = to_spanel(ctx);
+
+	return sysfs_emit(buf, "%u %u\n", spanel->frame_rate_hint, spanel->hint_vrefresh);
+}
+
+/* write the content frame rate, or 0 to clear the hint */
+static ssize_t frame_rate_hint_store(struct device *dev, struct device_attribute *attr,
+				     const char *buf, size_t count)
+{
+	struct mipi_dsi_device *dsi = to_mipi_dsi_device(dev);
+	struct exynos_panel *ctx = mipi_dsi_get_drvdata(dsi);
+	struct hk3_panel *spanel = to_spanel(ctx);
+	u32 hint;
+	int ret;
+
+	ret = kstrtou32(buf, 0, &hint);
+	if (ret)
+		return ret;
+
+	mutex_lock(&ctx->mode_lock);
+	if (spanel->frame_rate_hint != hint) {
+		spanel->frame_rate_hint = hint;
+		if (ctx->panel_state == PANEL_STATE_NORMAL && ctx->current_mode &&
+		    !ctx->current_mode->exynos_mode.is_lp_mode) {
+			DPU_ATRACE_BEGIN(__func__);
+			hk3_change_frequency(ctx, ctx->current_mode);
+			DPU_ATRACE_END(__func__);
+		}
+	}
+	mutex_unlock(&ctx->mode_lock);
+
+	return count;
+}
+static DEVICE_ATTR_RW(frame_rate_hint);
+
+static struct attribute *hk3_attrs[] = {
+	&dev_attr_frame_rate_hint.attr,
+	NULL
+};
+
+static const struct attribute_group hk3_attr_group = {
+	.attrs = hk3_attrs,
+};
+
+static void hk3_cancel_cmd_works(void *data)
+{
+	struct hk3_panel *spanel = data;
+
+	kthread_cancel_delayed_work_sync(&spanel->bcl.restore_work);
+	kthread_cancel_work_sync(&spanel->vreg_req.work);
+	kthread_cancel_work_sync(&spanel->opr_req.work);
+}
+
 static int hk3_panel_probe(struct mipi_dsi_device *dsi)
 {
+	const struct exynos_panel_desc *desc;
 	struct hk3_panel *spanel;
+	int ret;
 
 	spanel = devm_kzalloc(&dsi->dev, sizeof(*spanel), GFP_KERNEL);
 	if (!spanel)
 		return -ENOMEM;
 
 	spanel->base.op_hz = 120;
+
+	desc = of_device_get_match_data(&dsi->dev);
+	if (!desc || !desc->brt_capability)
+		return -ENODEV;
+	/* exynos_panel_common_init() may already look up nits, so fill the table before it */
+	ret = panel_google_brt_lut_alloc(&spanel->brt_lut, &spanel->base, &dsi->dev);
+	if (ret)
+		return ret;
+	panel_google_brt_lut_init(&spanel->brt_lut, desc->brt_capability, HK3_HBM_NITS_SLOPE,
+				  HK3_HBM_NITS_OFFSET);
+
 	spanel->hw_vrefresh = 60;
 	spanel->hw_acl_setting = 0;
 	spanel->hw_za_enabled = false;
 	spanel->hw_dbv = 0;
+	spanel->idle_floor_vrefresh = hk3_get_idle_floor(0);
 	/* ddic default temp */
 	spanel->hw_temp = 25;
+	seqlock_init(&spanel->hw_state_lock);
+	spin_lock_init(&spanel->trans_log.lock);
+	hk3_publish_hw_state(spanel);
 	spanel->pending_temp_update = false;
 	spanel->is_pixel_off = false;
 	spanel->read_vreg = false;
+	spanel->derate_level = 0;
+	spanel->derate_max_dbv = HK3_DERATE_MAX_DBV;
+	panel_google_bcl_init(&spanel->bcl, &spanel->base, panel_google_bcl_brt_cap_max_dbv,
+			      hk3_apply_dbv_cap);
+	hk3_init_read_req(&spanel->base, &spanel->vreg_req, 0xF4, 0x31, HK3_VREG_PARAM_NUM,
+			  hk3_vreg_read_done);
+	hk3_init_read_req(&spanel->base, &spanel->opr_req, 0x91, 0xE7, HK3_OPR_VAL_LEN,
+			  hk3_opr_read_done);
+
+	spanel->cmd_worker = panel_google_create_cmd_worker(&dsi->dev);
+	if (IS_ERR(spanel->cmd_worker))
+		return PTR_ERR(spanel->cmd_worker);
+
+	ret = exynos_panel_common_init(dsi, &spanel->base);
+	if (ret)
+		return ret;
+
+	ret = devm_add_action_or_reset(&dsi->dev, hk3_cancel_cmd_works, spanel);
+	if (ret)
+		return ret;
 
-	return exynos_panel_common_init(dsi, &spanel->base);
+	ret = devm_device_add_group(&dsi->dev, &hk3_attr_group);
+	if (ret)
+		dev_warn(&dsi->dev, "failed to add sysfs attributes: %d\n", ret);
+
+	panel_google_bcl_register(&spanel->bcl, &dsi->dev, spanel->cmd_worker, "display-bcl-hk3");
+
+	return 0;
 }
 
 static int hk3_panel_config(struct exynos_panel *ctx)
@@ -2671,7 +3759,7 @@ static int hk3_panel_config(struct exynos_panel *ctx)
 static const struct drm_panel_funcs hk3_drm_funcs = {
 	.disable = hk3_disable,
 	.unprepare = exynos_panel_unprepare,
-	.prepare = exynos_panel_prepare,
+	.prepare = hk3_prepare,
 	.enable = hk3_enable,
 	.get_modes = exynos_panel_get_modes,
 };
@@ -6,12 +6,16 @@
  */
 
 #include <drm/drm_vblank.h>
+#include <linux/debugfs.h>
+#include <linux/kthread.h>
 #include <linux/module.h>
 #include <linux/of_platform.h>
+#include <linux/slab.h>
 #include <video/mipi_display.h>
 
 #include "include/trace/dpu_trace.h"
 #include "panel/panel-samsung-drv.h"
+#include "panel-google-common.h"
 
 static const struct drm_dsc_config pps_config = {
 	.line_buf_depth = 9,
@@ -196,6 +200,20 @@ static const struct exynos_dsi_cmd shoreline_init_cmds[] = {
 };
 static DEFINE_EXYNOS_CMD_SET(shoreline_init);
 
+/* command sets resolved for the panel revision, with transfer counts in debugfs */
+enum shoreline_cmd_set_id {
+	CMD_SET_VGH_INIT,
+	CMD_SET_VREG_INIT,
+	CMD_SET_INIT,
+	CMD_SET_MAX,
+};
+
+static const struct exynos_dsi_cmd_set *shoreline_cmd_sets[CMD_SET_MAX] = {
+	[CMD_SET_VGH_INIT] = &shoreline_vgh_init_cmd_set,
+	[CMD_SET_VREG_INIT] = &shoreline_vreg_init_cmd_set,
+	[CMD_SET_INIT] = &shoreline_init_cmd_set,
+};
+
 #define LHBM_GAMMA_CMD_SIZE 6
 #define VREG_SET_CMD_SIZE 8
 
@@ -232,6 +250,7 @@ enum shoreline_lhbm_brt_overdrive_group {
 	LHBM_OVERDRIVE_GRP_300_NIT,
 	LHBM_OVERDRIVE_GRP_MAX
 };
+static_assert(LHBM_OVERDRIVE_GRP_MAX == PANEL_GOOGLE_LHBM_OD_GRP_MAX);
 
 struct shoreline_lhbm_ctl {
 	/** @brt_normal: normal LHBM brightness parameters */
@@ -244,6 +263,10 @@ struct shoreline_lhbm_ctl {
 	bool hist_roi_configured;
 };
 
+/* luminance model above the normal range */
+#define SHORELINE_HBM_NITS_SLOPE 645
+#define SHORELINE_HBM_NITS_OFFSET -1256
+
 /**
  * struct shoreline_panel - panel specific runtime info
  *
@@ -258,13 +281,39 @@ struct shoreline_panel {
 	u8 lhbm_gamma[LHBM_GAMMA_CMD_SIZE];
 	/** @lhbm_ctl: lhbm brightness control */
 	struct shoreline_lhbm_ctl lhbm_ctl;
+	/** @brt_lut: brightness lookup table indexed by DBV */
+	struct panel_google_brt_lut brt_lut;
 
 	/** @vreg_cmd: vreg data */
 	u8 vreg_cmd[VREG_SET_CMD_SIZE];
+
+	/** @bcl: cooling device used by BCL to shed panel current */
+	struct panel_google_bcl bcl;
+	/**
+	 * @cmd_worker: high priority worker owned by this panel, deferred panel commands are
+	 *		queued here instead of the shared system workqueue
+	 */
+	struct kthread_worker *cmd_worker;
+	/** @pwr_on: timeline of the latest power on */
+	struct panel_google_pwr_on_timeline pwr_on;
+	/** @cmd_sets: command sets resolved for the panel revision */
+	struct panel_google_cmd_set cmd_sets[CMD_SET_MAX];
 };
 
 #define to_spanel(ctx) container_of(ctx, struct shoreline_panel, base)
 
+/* send the copy of a command set resolved for the panel revision */
+static void shoreline_send_cmd_set(struct exynos_panel *ctx, enum shoreline_cmd_set_id id)
+{
+	panel_google_send_cmd_set(ctx, shoreline_cmd_sets[id], &to_spanel(ctx)->cmd_sets[id]);
+}
+
+/* filter and pack a command set once the panel revision is known */
+static void shoreline_resolve_cmd_set(struct exynos_panel *ctx, enum shoreline_cmd_set_id id)
+{
+	panel_google_resolve_cmd_set(ctx, shoreline_cmd_sets[id], &to_spanel(ctx)->cmd_sets[id]);
+}
+
 static void shoreline_lhbm_gamma_read(struct exynos_panel *ctx)
 {
 	struct mipi_dsi_device *dsi = to_mipi_dsi_device(ctx->dev);
@@ -612,6 +661,14 @@ static void shoreline_set_nolp_mode(struct exynos_panel *ctx,
 	dev_info(ctx->dev, "exit LP mode\n");
 }
 
+static int shoreline_prepare(struct drm_panel *panel)
+{
+	struct exynos_panel *ctx = container_of(panel, struct exynos_panel, panel);
+	struct shoreline_panel *spanel = to_spanel(ctx);
+
+	return panel_google_pwr_on_prepare(panel, &spanel->pwr_on);
+}
+
 static int shoreline_enable(struct drm_panel *panel)
 {
 	struct exynos_panel *ctx = container_of(panel, struct exynos_panel, panel);
@@ -629,6 +686,7 @@ static int shoreline_enable(struct drm_panel *panel)
 	dev_dbg(ctx->dev, "%s\n", __func__);
 
 	exynos_panel_reset(ctx);
+	panel_google_mark_pwr_on(&spanel->pwr_on, PANEL_GOOGLE_PWR_ON_RESET);
 
 	/* DSC related configuration */
 	drm_dsc_pps_payload_pack(&pps_payload, &pps_config);
@@ -638,12 +696,13 @@ static int shoreline_enable(struct drm_panel *panel)
 	EXYNOS_DCS_WRITE_SEQ_DELAY(ctx, 5, MIPI_DCS_EXIT_SLEEP_MODE);
 
 	if (ctx->panel_rev < PANEL_REV_DVT1)
-		exynos_panel_send_cmd_set(ctx, &shoreline_vgh_init_cmd_set);
+		shoreline_send_cmd_set(ctx, CMD_SET_VGH_INIT);
 
 	if (spanel->vreg_cmd[0])
-		exynos_panel_send_cmd_set(ctx, &shoreline_vreg_init_cmd_set);
+		shoreline_send_cmd_set(ctx, CMD_SET_VREG_INIT);
 
-	exynos_panel_send_cmd_set(ctx, &shoreline_init_cmd_set);
+	shoreline_send_cmd_set(ctx, CMD_SET_INIT);
+	panel_google_mark_pwr_on(&spanel->pwr_on, PANEL_GOOGLE_PWR_ON_INIT);
 
 	shoreline_change_frequency(ctx, drm_mode_vrefresh(mode));
 
@@ -661,6 +720,8 @@ static int shoreline_enable(struct drm_panel *panel)
 	spanel->lhbm_ctl.hist_roi_configured = false;
 	ctx->dsi_hs_clk = MIPI_DSI_FREQ_DEFAULT;
 
+	panel_google_pwr_on_done(&spanel->pwr_on, ctx->dev);
+
 	return 0;
 }
 
@@ -770,31 +831,10 @@ static void shoreline_set_local_hbm_brightness(struct exynos_panel *ctx, bool is
 	if (is_first_stage) {
 		u32 gray = exynos_drm_connector_get_lhbm_gray_level(&ctx->exynos_connector);
 		u32 dbv = exynos_panel_get_brightness(ctx);
-		u32 normal_dbv_max = ctx->desc->brt_capability->normal.level.max;
-		u32 normal_nit_max = ctx->desc->brt_capability->normal.nits.max;
-		u32 luma = 0;
 
-		if (gray < 15) {
-			group = LHBM_OVERDRIVE_GRP_0_NIT;
-		} else {
-			if (dbv <= normal_dbv_max)
-				luma = panel_cmn_calc_gamma_2_2_luminance(dbv, normal_dbv_max,
-				normal_nit_max);
-			else
-				luma = panel_cmn_calc_linear_luminance(dbv, 645, -1256);
-			luma = panel_cmn_calc_gamma_2_2_luminance(gray, 255, luma);
-
-			if (luma < 6)
-				group = LHBM_OVERDRIVE_GRP_6_NIT;
-			else if (luma < 50)
-				group = LHBM_OVERDRIVE_GRP_50_NIT;
-			else if (luma < 300)
-				group = LHBM_OVERDRIVE_GRP_300_NIT;
-			else
-				group = LHBM_OVERDRIVE_GRP_MAX;
-		}
-		dev_dbg(ctx->dev, "check LHBM overdrive condition | gray=%u dbv=%u luma=%u\n",
-			gray, dbv, luma);
+		group = panel_google_get_lhbm_od_group(&spanel->brt_lut, dbv, gray);
+		dev_dbg(ctx->dev, "check LHBM overdrive condition | gray=%u dbv=%u nits=%u\n",
+			gray, dbv, panel_google_get_brt_lut(&spanel->brt_lut, dbv)->nits);
 	}
 
 	if (group < LHBM_OVERDRIVE_GRP_MAX) {
@@ -942,12 +982,23 @@ static void shoreline_lhbm_brightness_init(struct exynos_panel *ctx)
 		ctl->brt_overdrive, sizeof(ctl->brt_overdrive), false);
 }
 
+static const char * const shoreline_cmd_set_names[CMD_SET_MAX] = {
+	[CMD_SET_VGH_INIT] = "vgh_init",
+	[CMD_SET_VREG_INIT] = "vreg_init",
+	[CMD_SET_INIT] = "init",
+};
+
 static void shoreline_panel_init(struct exynos_panel *ctx)
 {
+	struct shoreline_panel *spanel = to_spanel(ctx);
 	struct dentry *csroot = ctx->debugfs_cmdset_entry;
 
 	exynos_panel_debugfs_create_cmdset(ctx, csroot,
 					   &shoreline_init_cmd_set, "init");
+	panel_google_pwr_on_debugfs_init(&spanel->pwr_on, ctx->debugfs_entry);
+	panel_google_brt_lut_debugfs_init(&spanel->brt_lut, ctx->debugfs_entry);
+	panel_google_cmd_set_debugfs_init(ctx->dev, ctx->debugfs_entry, spanel->cmd_sets,
+					  shoreline_cmd_set_names, CMD_SET_MAX);
 	shoreline_lhbm_gamma_read(ctx);
 	shoreline_lhbm_gamma_write(ctx);
 
@@ -955,6 +1006,9 @@ static void shoreline_panel_init(struct exynos_panel *ctx)
 
 	/* LHBM overdrive init */
 	shoreline_lhbm_brightness_init(ctx);
+	/* the brightness capability depends on the panel revision, known from here on */
+	panel_google_brt_lut_init(&spanel->brt_lut, ctx->desc->brt_capability,
+				  SHORELINE_HBM_NITS_SLOPE, SHORELINE_HBM_NITS_OFFSET);
 	/* LHBM Location */
 	EXYNOS_DCS_WRITE_TABLE(ctx, test_key_on_f0);
 	EXYNOS_DCS_WRITE_SEQ(ctx, 0xB0, 0x00, 0x09, 0x6D);
@@ -975,19 +1029,68 @@ static void shoreline_get_panel_rev(struct exynos_panel *ctx, u32 id)
 	const u8 sub = (build_code & 0x0C) >> 2;
 
 	exynos_panel_get_panel_rev(ctx, main | sub);
+
+	/* filter and pack the command sets once the panel revision is known */
+	if (ctx->panel_rev < PANEL_REV_DVT1)
+		shoreline_resolve_cmd_set(ctx, CMD_SET_VGH_INIT);
+	shoreline_resolve_cmd_set(ctx, CMD_SET_VREG_INIT);
+	shoreline_resolve_cmd_set(ctx, CMD_SET_INIT);
+}
+
+static int shoreline_set_brightness(struct exynos_panel *ctx, u16 br)
+{
+	struct shoreline_panel *spanel = to_spanel(ctx);
+
+	if (ctx->current_mode && !ctx->current_mode->exynos_mode.is_lp_mode &&
+	    br > spanel->bcl.max_dbv) {
+		dev_dbg(ctx->dev, "%s: cap dbv %u to %u\n", __func__, br, spanel->bcl.max_dbv);
+		br = spanel->bcl.max_dbv;
+	}
+
+	return exynos_panel_set_brightness(ctx, br);
+}
+
+static void shoreline_cancel_cmd_works(void *data)
+{
+	struct shoreline_panel *spanel = data;
+
+	kthread_cancel_delayed_work_sync(&spanel->bcl.restore_work);
 }
 
 static int shoreline_panel_probe(struct mipi_dsi_device *dsi)
 {
 	struct shoreline_panel *spanel;
+	int ret;
 
 	spanel = devm_kzalloc(&dsi->dev, sizeof(*spanel), GFP_KERNEL);
 	if (!spanel)
 		return -ENOMEM;
 
 	spanel->base.op_hz = 120;
+	/* no ACL control in the driver, so BCL mitigation caps dbv only */
+	panel_google_bcl_init(&spanel->bcl, &spanel->base, panel_google_bcl_brt_cap_max_dbv,
+			      panel_google_bcl_reapply_brightness);
 
-	return exynos_panel_common_init(dsi, &spanel->base);
+	ret = panel_google_brt_lut_alloc(&spanel->brt_lut, &spanel->base, &dsi->dev);
+	if (ret)
+		return ret;
+
+	spanel->cmd_worker = panel_google_create_cmd_worker(&dsi->dev);
+	if (IS_ERR(spanel->cmd_worker))
+		return PTR_ERR(spanel->cmd_worker);
+
+	ret = exynos_panel_common_init(dsi, &spanel->base);
+	if (ret)
+		return ret;
+
+	ret = devm_add_action_or_reset(&dsi->dev, shoreline_cancel_cmd_works, spanel);
+	if (ret)
+		return ret;
+
+	panel_google_bcl_register(&spanel->bcl, &dsi->dev, spanel->cmd_worker,
+				  "display-bcl-shoreline");
+
+	return 0;
 }
 
 
@@ -1099,7 +1202,7 @@ static const struct exynos_panel_mode shoreline_lp_mode = {
 static const struct drm_panel_funcs shoreline_drm_funcs = {
 	.disable = shoreline_disable,
 	.unprepare = exynos_panel_unprepare,
-	.prepare = exynos_panel_prepare,
+	.prepare = shoreline_prepare,
 	.enable = shoreline_enable,
 	.get_modes = exynos_panel_get_modes,
 };
@@ -1107,7 +1210,7 @@ static const struct drm_panel_funcs shoreline_drm_funcs = {
 static int shoreline_panel_config(struct exynos_panel *ctx);
 
 static const struct exynos_panel_funcs shoreline_exynos_funcs = {
-	.set_brightness = exynos_panel_set_brightness,
+	.set_brightness = shoreline_set_brightness,
 	.set_lp_mode = shoreline_set_lp_mode,
 	.set_nolp_mode = shoreline_set_nolp_mode,
 	.set_binned_lp = exynos_panel_set_binned_lp,
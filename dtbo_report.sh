@@ -0,0 +1,137 @@
+#!/bin/bash
+# SPDX-License-Identifier: GPL-2.0
+#
+# Report the size and overlay-apply cost of the shusky board overlays.
+#
+# Usage:
+#   dtbo_report.sh <dist_dir> [baseline_report]
+#
+# <dist_dir> is the output of build_shusky.sh, containing the board *.dtbo, the
+# base zuma-[ab]0-*.dtb and dtbo.img. The report goes to stdout as "key value" lines so
+# two runs can be compared; pass the report of an earlier run as
+# [baseline_report] to print the delta of every key next to it.
+#
+# Besides size and fdtoverlay time per overlay, the report counts the properties
+# each overlay shares with every other overlay of the same family (husky, shiba),
+# which is the content that could move into a shared base overlay.
+#
+# Needs dtc and fdtoverlay from the kernel tree or the dtc package in PATH.
+
+function exit_if_error {
+  if [ $1 -ne 0 ]; then
+    echo "ERROR: $2: retval=$1" >&2
+    exit $1
+  fi
+}
+
+DIST_DIR=$1
+BASELINE=$2
+# fdtoverlay runs per overlay and base dtb, averaged to smooth out host noise
+APPLY_RUNS=${APPLY_RUNS:-10}
+
+if [ -z "${DIST_DIR}" ] || [ ! -d "${DIST_DIR}" ]; then
+  echo "usage: $0 <dist_dir> [baseline_report]" >&2
+  exit 1
+fi
+
+for tool in dtc fdtoverlay; do
+  command -v ${tool} > /dev/null
+  exit_if_error $? "${tool} not found in PATH"
+done
+
+WORK_DIR=`mktemp -d`
+trap "rm -rf ${WORK_DIR}" EXIT
+
+REPORT=${WORK_DIR}/report
+
+function report {
+  echo "$1 $2" >> ${REPORT}
+}
+
+# Flatten an overlay into sorted "path/property = value" lines, dropping the
+# fragment and fixup bookkeeping that differs between otherwise equal content.
+function flatten_dtbo {
+  dtc -q -I dtb -O dts "$1" 2> /dev/null | awk '
+    /^[ \t]*[^ \t].*\{[ \t]*$/ {
+      name = $1
+      if (name == "/") name = ""
+      path[++depth] = name
+      next
+    }
+    /^[ \t]*\};[ \t]*$/ { depth--; next }
+    /=|;[ \t]*$/ {
+      p = ""
+      for (i = 1; i <= depth; i++)
+        if (path[i] !~ /^(fragment@|__overlay__|__fixups__|__local_fixups__|__symbols__)/)
+          p = p "/" path[i]
+      gsub(/^[ \t]+/, "")
+      print p "/" $0
+    }' | sort -u
+}
+
+BASE_DTBS=`ls ${DIST_DIR}/zuma-[ab]0-*.dtb 2> /dev/null`
+if [ -z "${BASE_DTBS}" ]; then
+  echo "ERROR: no base dtb in ${DIST_DIR}" >&2
+  exit 1
+fi
+
+total_size=0
+total_apply_us=0
+overlays=0
+for dtbo in ${DIST_DIR}/zuma-husky-*.dtbo ${DIST_DIR}/zuma-shiba-*.dtbo \
+    ${DIST_DIR}/zuma-ripcurrent*.dtbo; do
+  [ -f "${dtbo}" ] || continue
+  name=`basename ${dtbo} .dtbo`
+  size=`stat -c %s ${dtbo}`
+  report "${name}.size" ${size}
+  total_size=$((total_size + size))
+
+  apply_ns=0
+  for base in ${BASE_DTBS}; do
+    start=`date +%s%N`
+    for run in `seq ${APPLY_RUNS}`; do
+      fdtoverlay -i ${base} -o ${WORK_DIR}/applied.dtb ${dtbo}
+      exit_if_error $? "failed to apply ${name} on `basename ${base}`"
+    done
+    end=`date +%s%N`
+    apply_ns=$((apply_ns + (end - start) / APPLY_RUNS))
+  done
+  apply_us=$((apply_ns / `echo ${BASE_DTBS} | wc -w` / 1000))
+  report "${name}.apply_us" ${apply_us}
+  total_apply_us=$((total_apply_us + apply_us))
+
+  flatten_dtbo ${dtbo} > ${WORK_DIR}/${name}.props
+  report "${name}.props" `wc -l < ${WORK_DIR}/${name}.props`
+  overlays=$((overlays + 1))
+done
+
+if [ ${overlays} -eq 0 ]; then
+  echo "ERROR: no board overlay in ${DIST_DIR}" >&2
+  exit 1
+fi
+
+report "total.overlays" ${overlays}
+report "total.size" ${total_size}
+report "total.apply_us" ${total_apply_us}
+if [ -f ${DIST_DIR}/dtbo.img ]; then
+  report "dtbo.img.size" `stat -c %s ${DIST_DIR}/dtbo.img`
+fi
+
+# Content common to all overlays of a family could live in one shared overlay.
+for family in husky shiba; do
+  props=`ls ${WORK_DIR}/zuma-${family}-*.props 2> /dev/null`
+  [ -n "${props}" ] || continue
+  count=`echo ${props} | wc -w`
+  common=`cat ${props} | sort | uniq -c | awk -v n=${count} '$1 == n' | wc -l`
+  report "${family}.common_props" ${common}
+  # properties that are duplicated in every overlay but the first one
+  report "${family}.duplicated_props" $((common * (count - 1)))
+done
+
+if [ -n "${BASELINE}" ]; then
+  awk 'NR == FNR { base[$1] = $2; next }
+       { d = ($1 in base) ? sprintf("%+d", $2 - base[$1]) : "new"; print $1, $2, d }' \
+    ${BASELINE} ${REPORT}
+else
+  cat ${REPORT}
+fi